@@ -0,0 +1,427 @@
+/*
+ * Demolito, a UCI chess engine. Copyright 2015-2020 lucasart.
+ *
+ * Demolito is free software: you can redistribute it and/or modify it under the terms of the GNU
+ * General Public License as published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * Demolito is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with this program. If
+ * not, see <http://www.gnu.org/licenses/>.
+ */
+#include "bench.h"
+#include "bitboard.h"
+#include "epd.h"
+#include "gen.h"
+#include "htable.h"
+#include "perft.h"
+#include "platform.h"
+#include "position.h"
+#include "search.h"
+#include "uci.h"
+#include "util.h"
+#include "workers.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char *Fens[] = {
+#include "test.csv"
+    NULL};
+
+void bench(int depth) {
+    uint64_t nodes = 0;
+    uciChess960 = true;
+
+    lim = (Limits){0};
+    lim.depth = depth;
+
+    int64_t start = system_msec();
+
+    for (int i = 0; Fens[i]; i++) {
+        pos_set(&rootPos, Fens[i]);
+        zobrist_clear(&rootStack);
+        zobrist_push(&rootStack, rootPos.key);
+
+        puts(Fens[i]);
+        nodes += search_go();
+        puts("");
+    }
+
+    if (dbgCnt[0] || dbgCnt[1])
+        printf("dbgCnt[0] = %" PRId64 ", dbgCnt[1] = %" PRId64 "\n", dbgCnt[0], dbgCnt[1]);
+
+    const int64_t elapsed = system_msec() - start;
+
+    printf("time  : %" PRIu64 "ms\n", elapsed);
+    printf("nodes : %" PRIu64 "\n", nodes); // total nodes = functionality signature
+    printf("nps   : %.0f\n", (double)nodes * 1000.0 / (double)max(elapsed, 1)); // avoid div/0
+    workers_print_aspiration();
+
+#ifdef STATS
+    workers_print_stats();
+    workers_print_cutoffs();
+#endif
+}
+
+typedef struct {
+    uint64_t nodes;
+    int64_t time; // ms
+} Sample;
+
+static int StatsDepth;
+static size_t FenCount;
+static Sample *Samples;    // [run][worker][position]
+static Sample *RunSamples; // Samples of the current run
+
+static void *bench_stats_posix(void *_worker) {
+    Worker *worker = _worker;
+    const size_t idx = (size_t)(worker - Workers);
+    const Limits limits = {.depth = StatsDepth};
+    move_t pv[MAX_PLY + 1];
+
+    // Each thread uses its own partition of the hash table, cleared before each run
+    worker->hash = hash_partition(idx, WorkersCount);
+    hash_clear_partition(&worker->hash);
+
+    for (size_t i = 0; i < FenCount; i++) {
+        Position pos;
+        pos_set(&pos, Fens[i]);
+        zobrist_clear(&worker->stack);
+        zobrist_push(&worker->stack, pos.key);
+
+        const int64_t start = system_msec();
+        search_solo(worker, &pos, &limits, pv);
+        RunSamples[idx * FenCount + i] = (Sample){worker->nodes, system_msec() - start};
+    }
+
+    return NULL;
+}
+
+// Mean, standard deviation, and half width of the 95% confidence interval of the mean (Student)
+static void stats(const double x[], int n, double *mean, double *stddev, double *ci95) {
+    static const double T975[] = {0,      12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365,
+                                  2.306,  2.262,  2.228, 2.201, 2.179, 2.160, 2.145, 2.131,
+                                  2.120,  2.110,  2.101, 2.093, 2.086, 2.080, 2.074, 2.069,
+                                  2.064,  2.060,  2.056, 2.052, 2.048, 2.045, 2.042};
+    double sum = 0, sum2 = 0;
+
+    for (int i = 0; i < n; i++)
+        sum += x[i];
+
+    *mean = sum / n;
+
+    for (int i = 0; i < n; i++)
+        sum2 += (x[i] - *mean) * (x[i] - *mean);
+
+    *stddev = n > 1 ? sqrt(sum2 / (n - 1)) : 0;
+    *ci95 = (n - 1 <= 30 ? T975[n - 1] : 1.96) * *stddev / sqrt(n);
+}
+
+void bench_stats(int depth, int runs, bool csv) {
+    runs = max(runs, 1);
+    uciChess960 = true;
+    StatsDepth = depth;
+
+    for (FenCount = 0; Fens[FenCount]; FenCount++)
+        ;
+
+    const size_t samplesPerRun = WorkersCount * FenCount;
+    Samples = malloc((size_t)runs * samplesPerRun * sizeof(Sample));
+    double *nps = malloc((size_t)runs * sizeof(double));
+
+    for (int r = 0; r < runs; r++) {
+        RunSamples = &Samples[(size_t)r * samplesPerRun];
+        workers_clear(); // each run starts from the same state
+        pthread_t threads[WorkersCount];
+        const int64_t start = system_msec();
+
+        for (size_t i = 0; i < WorkersCount; i++)
+            pthread_create(&threads[i], NULL, bench_stats_posix, &Workers[i]);
+
+        for (size_t i = 0; i < WorkersCount; i++)
+            pthread_join(threads[i], NULL);
+
+        const int64_t elapsed = system_msec() - start;
+        uint64_t nodes = 0;
+
+        for (size_t i = 0; i < samplesPerRun; i++)
+            nodes += RunSamples[i].nodes;
+
+        nps[r] = (double)nodes * 1000.0 / (double)max(elapsed, 1); // all workers combined
+    }
+
+    double mean, stddev, ci95;
+    stats(nps, runs, &mean, &stddev, &ci95);
+
+    if (csv) {
+        puts("run,worker,position,nodes,time_ms");
+
+        for (int r = 0; r < runs; r++)
+            for (size_t w = 0; w < WorkersCount; w++)
+                for (size_t i = 0; i < FenCount; i++) {
+                    const Sample *s = &Samples[((size_t)r * WorkersCount + w) * FenCount + i];
+                    printf("%d,%zu,%zu,%" PRIu64 ",%" PRId64 "\n", r, w, i, s->nodes, s->time);
+                }
+
+        printf("\nmetric,value\nnps_mean,%.0f\nnps_stddev,%.0f\nnps_ci95_low,%.0f\n"
+               "nps_ci95_high,%.0f\n",
+               mean, stddev, mean - ci95, mean + ci95);
+    } else {
+        printf("{\n  \"depth\": %d,\n  \"runs\": %d,\n  \"workers\": %zu,\n", depth, runs,
+               WorkersCount);
+        printf("  \"nps\": {\"mean\": %.0f, \"stddev\": %.0f, \"ci95\": [%.0f, %.0f], \"runs\": [",
+               mean, stddev, mean - ci95, mean + ci95);
+
+        for (int r = 0; r < runs; r++)
+            printf("%s%.0f", r ? ", " : "", nps[r]);
+
+        puts("]},\n  \"positions\": [");
+        const int n = runs * (int)WorkersCount;
+        double *times = malloc((size_t)n * sizeof(double));
+
+        for (size_t i = 0; i < FenCount; i++) {
+            for (int j = 0; j < n; j++)
+                times[j] = (double)Samples[(size_t)j * FenCount + i].time;
+
+            stats(times, n, &mean, &stddev, &ci95);
+            printf("    {\"fen\": \"%s\", \"nodes\": %" PRIu64
+                   ", \"time_ms\": {\"mean\": %.1f, \"stddev\": %.1f}}%s\n",
+                   Fens[i], Samples[i].nodes, mean, stddev, i + 1 < FenCount ? "," : "");
+        }
+
+        puts("  ]\n}");
+        free(times);
+    }
+
+    free(nps);
+    free(Samples);
+}
+
+void smp_bench(const char *fileName, int depth, size_t maxThreads) {
+    EpdEntry *entries = NULL;
+    size_t count = 0;
+
+    if (fileName) {
+        if (!(entries = epd_load(fileName, &count))) {
+            printf("cannot open '%s'\n", fileName);
+            return;
+        }
+    } else {
+        uciChess960 = true;
+
+        for (; Fens[count]; count++) {
+            entries = realloc(entries, (count + 1) * sizeof(EpdEntry));
+            epd_parse(&entries[count], Fens[count]);
+        }
+    }
+
+    enum { MAX_RUNS = 16 };
+    size_t threads[MAX_RUNS], runs = 0;
+    int64_t timeToDepth[MAX_RUNS] = {0}, timeToSolution[MAX_RUNS] = {0};
+    int solved[MAX_RUNS] = {0}, withSolution = 0;
+
+    for (size_t t = 1; t < maxThreads && runs < MAX_RUNS - 1; t *= 2)
+        threads[runs++] = t;
+
+    threads[runs++] = maxThreads;
+
+    for (size_t r = 0; r < runs; r++) {
+        workers_prepare(threads[r]);
+        withSolution = 0;
+
+        for (size_t i = 0; i < count; i++) {
+            // Each search starts from cleared tables
+            hash_clear();
+            workers_clear();
+
+            rootPos = entries[i].pos;
+            zobrist_clear(&rootStack);
+            zobrist_push(&rootStack, rootPos.key);
+            lim = (Limits){.depth = depth};
+
+            const int64_t start = system_msec();
+            search_go();
+            const int64_t elapsed = system_msec() - start;
+            timeToDepth[r] += elapsed;
+
+            // The search is over, so ui is not accessed concurrently anymore
+            if (entries[i].bmCount || entries[i].amCount) {
+                withSolution++;
+
+                if (epd_solved(&entries[i], ui.best)) {
+                    solved[r]++;
+                    timeToSolution[r] += min(ui.bestTime, elapsed);
+                } else
+                    timeToSolution[r] += elapsed;
+            }
+        }
+    }
+
+    printf("\nthreads  time to depth  speedup");
+
+    if (withSolution)
+        printf("  solved  time to solution  speedup");
+
+    puts("");
+
+    for (size_t r = 0; r < runs; r++) {
+        printf("%7zu %12" PRId64 "ms %8.2f", threads[r], timeToDepth[r],
+               (double)timeToDepth[0] / (double)max(timeToDepth[r], 1));
+
+        if (withSolution)
+            printf(" %4d/%-3d %15" PRId64 "ms %8.2f", solved[r], withSolution, timeToSolution[r],
+                   (double)timeToSolution[0] / (double)max(timeToSolution[r], 1));
+
+        puts("");
+    }
+
+    free(entries);
+}
+
+// Time one replay of the transcript: position commands of increasing length, as sent by a GUI
+// over a game. Returns the total time in us.
+static int64_t position_replay(const char *transcript, const size_t ends[], int plies, char *line,
+                               bool incremental) {
+    const int64_t start = system_usec();
+
+    for (int i = 1; i <= plies; i++) {
+        char *linePos;
+        memcpy(line, transcript, ends[i]);
+        line[ends[i]] = '\0';
+        strtok_r(line, " \n", &linePos); // consume "position"
+        uci_position(&linePos, incremental);
+    }
+
+    return system_usec() - start;
+}
+
+void position_bench(int plies, int runs) {
+    plies = max(plies, 1);
+    plies = min(plies, MAX_GAME_PLY - 2);
+    char *transcript = malloc(32 + 6 * (size_t)plies), *line = malloc(32 + 6 * (size_t)plies);
+    size_t *ends = malloc((size_t)(plies + 1) * sizeof(size_t)); // ends[i]: command with i moves
+
+    // Random game from the start position, with a fixed seed. It stops early on mate, stalemate, or
+    // when the 50 move rule could be claimed.
+    Position pos[NB_COLOR];
+    int idx = 0;
+    uint64_t seed = 0;
+    pos_set(&pos[idx], "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1");
+
+    strcpy(transcript, "position startpos moves");
+    ends[0] = strlen(transcript);
+
+    for (int i = 1; i <= plies; i++) {
+        move_t mList[MAX_MOVES];
+        const move_t *end = gen_all_moves(&pos[idx], mList);
+
+        if (end == mList || pos[idx].rule50 >= 99) {
+            plies = i - 1;
+            break;
+        }
+
+        const move_t m = mList[prng(&seed) % (uint64_t)(end - mList)];
+        char str[6];
+        pos_move_to_string(&pos[idx], m, str);
+        pos_move(&pos[idx ^ 1], &pos[idx], m);
+        idx ^= 1;
+
+        ends[i] = ends[i - 1] + (size_t)sprintf(transcript + ends[i - 1], " %s", str);
+    }
+
+    int64_t full = 0, incremental = 0;
+    runs = max(runs, 1);
+
+    for (int r = 0; r < runs; r++) {
+        full += position_replay(transcript, ends, plies, line, false);
+        incremental += position_replay(transcript, ends, plies, line, true);
+    }
+
+    printf("commands    : %d x %d runs\n", plies, runs);
+    printf("full replay : %.2f us/command\n", (double)full / (runs * plies));
+    printf("incremental : %.2f us/command\n", (double)incremental / (runs * plies));
+    printf("root check  : %s\n", rootPos.key == pos[idx].key ? "ok" : "MISMATCH");
+
+    free(ends);
+    free(line);
+    free(transcript);
+}
+
+void perft_bench(const char *fen, int depth, size_t threads, size_t hashMB) {
+    Position pos;
+    pos_set(&pos, fen);
+
+    const int64_t start = system_msec();
+    const uint64_t nodes = perft(&pos, depth, threads, hashMB, true);
+    const int64_t elapsed = system_msec() - start;
+
+    printf("time  : %" PRIu64 "ms\n", elapsed);
+    printf("nodes : %" PRIu64 "\n", nodes);
+    printf("nps   : %.0f\n", (double)nodes * 1000.0 / (double)max(elapsed, 1)); // avoid div/0
+}
+
+void slider_bench(uint64_t lookups) {
+    enum { SAMPLES = 4096 };
+    int squares[SAMPLES];
+    bitboard_t occs[SAMPLES];
+    uint64_t seed = 0, checksum = 0;
+    printf("backend : %s\n", bb_backend());
+
+    for (int i = 0; i < SAMPLES; i++) {
+        squares[i] = (int)(prng(&seed) % NB_SQUARE);
+        occs[i] = prng(&seed) & prng(&seed); // 25% density, typical of middlegames
+    }
+
+    for (int piece = BISHOP; piece <= ROOK; piece++) {
+        const int64_t start = system_msec();
+
+        // Each occupancy depends on the previous result: measures latency, as in move generation
+        for (uint64_t n = 0; n < lookups; n++) {
+            const size_t i = n % SAMPLES;
+            checksum ^= piece == ROOK ? bb_rook_attacks(squares[i], occs[i] ^ checksum)
+                                      : bb_bishop_attacks(squares[i], occs[i] ^ checksum);
+        }
+
+        const int64_t elapsed = system_msec() - start;
+        printf("%s : %.2f ns/lookup\n", piece == ROOK ? "rook  " : "bishop",
+               (double)elapsed * 1e6 / (double)lookups);
+    }
+
+    printf("checksum : %" PRIx64 "\n", checksum); // prevent dead code elimination
+}
+
+void hash_bench(uint64_t hashMB) {
+    for (int compact = 0; compact <= 1; compact++) {
+        hash_prepare(hashMB, compact);
+        const HashTable ht = hash_partition(0, 1);
+        const uint64_t entries = ht.count * (compact ? BUCKET_ENTRIES : 1);
+        uint64_t seed = 0, retained = 0, falseHits = 0;
+
+        for (uint64_t i = 0; i < entries; i++) {
+            const uint64_t key = prng(&seed), r = prng(&seed);
+            HashEntry e = {.depth = (int8_t)(r % 32), .move = (move_t)(r >> 48)};
+            hash_write(&ht, key, &e, 0);
+        }
+
+        seed = 0; // replay the same sequence
+
+        for (uint64_t i = 0; i < entries; i++) {
+            const uint64_t key = prng(&seed), r = prng(&seed);
+            const HashEntry e = hash_read(&ht, key, 0);
+            retained += e.depth == (int8_t)(r % 32) && e.move == (move_t)(r >> 48);
+        }
+
+        for (uint64_t i = 0; i < entries; i++)
+            falseHits += hash_read(&ht, prng(&seed), 0).data != 0;
+
+        printf("layout     : %s\n", compact ? "compact" : "normal");
+        printf("entries    : %" PRIu64 " (%" PRIu64 " per MB)\n", entries, entries / hashMB);
+        printf("retained   : %.2f%% (%" PRIu64 " per MB)\n",
+               100.0 * (double)retained / (double)entries, retained / hashMB);
+        printf("false hits : %.4f%%\n\n", 100.0 * (double)falseHits / (double)entries);
+    }
+}
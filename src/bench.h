@@ -0,0 +1,48 @@
+/*
+ * Demolito, a UCI chess engine. Copyright 2015-2020 lucasart.
+ *
+ * Demolito is free software: you can redistribute it and/or modify it under the terms of the GNU
+ * General Public License as published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * Demolito is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with this program. If
+ * not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// Search the test.csv positions to depth, and print total time, nodes (functional signature) and
+// nodes per second
+void bench(int depth);
+
+// Repeat the test.csv searches to depth runs times, with one solo search (see search_solo())
+// running concurrently per Worker, and print NPS statistics and per position time and nodes, in
+// JSON or CSV. Each run starts from cleared tables, so nodes are the same for all runs and workers.
+void bench_stats(int depth, int runs, bool csv);
+
+// SMP scaling: search each position of an EPD file (test.csv if fileName is NULL) to depth, with 1,
+// 2, 4 ... maxThreads threads. Print the time to depth, and for positions with bm/am the time to
+// solution (when the final best move was found, or the whole search if it's wrong), with speedups
+// relative to 1 thread.
+void smp_bench(const char *fileName, int depth, size_t maxThreads);
+
+// Replay a UCI transcript of a random game of plies moves: one position command per move, each
+// resending the whole game. Time it runs times, with full and incremental parsing (see
+// uci_position()).
+void position_bench(int plies, int runs);
+
+// Perft to depth from fen (see perft()), printing the divide, and total time, nodes and NPS
+void perft_bench(const char *fen, int depth, size_t threads, size_t hashMB);
+
+// Micro-benchmark of the slider attack backend (see bitboard.c), on random squares and occupancies
+void slider_bench(uint64_t lookups);
+
+// Compare the hash table layouts (see htable.h): store as many random positions as the table has
+// entries, then measure how many are retained, and how often fresh positions produce a false hit.
+void hash_bench(uint64_t hashMB);
@@ -39,3 +39,4 @@ bool bb_several(bitboard_t b);
 int bb_count(bitboard_t b);
 
 void bb_print(bitboard_t b);
+const char *bb_backend(void); // slider attack and popcount implementation in use
@@ -0,0 +1,213 @@
+/*
+ * Demolito, a UCI chess engine. Copyright 2015-2020 lucasart.
+ *
+ * Demolito is free software: you can redistribute it and/or modify it under the terms of the GNU
+ * General Public License as published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * Demolito is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with this program. If
+ * not, see <http://www.gnu.org/licenses/>.
+ */
+#include "datagen.h"
+#include "gen.h"
+#include "htable.h"
+#include "platform.h"
+#include "search.h"
+#include "tune.h"
+#include "util.h"
+#include "workers.h"
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+enum {
+    RANDOM_PLIES = 8,      // random moves played from the start position, to diversify openings
+    MAX_GAME_PLIES = 400,  // adjudicate a draw beyond that
+    WIN_SCORE = 2000,      // adjudicate a win when |score| >= WIN_SCORE ...
+    WIN_PLIES = 4,         // ... for WIN_PLIES consecutive plies
+    BUFFER_SIZE = 1 << 16, // per thread write buffer, in bytes
+};
+
+typedef struct {
+    char data[BUFFER_SIZE];
+    size_t size;
+} Buffer;
+
+static FILE *Out;
+static mtx_t OutMtx;
+static bool Binary;
+static Limits GameLimits;
+static uint64_t GamesTotal;
+static atomic_uint_fast64_t GamesStarted, GamesDone, SamplesDone;
+
+static void buffer_flush(Buffer *buffer) {
+    mtx_lock(&OutMtx);
+    fwrite(buffer->data, 1, buffer->size, Out);
+    mtx_unlock(&OutMtx);
+
+    buffer->size = 0;
+}
+
+static void buffer_write(Buffer *buffer, const void *data, size_t size) {
+    if (buffer->size + size > BUFFER_SIZE)
+        buffer_flush(buffer);
+
+    memcpy(buffer->data + buffer->size, data, size);
+    buffer->size += size;
+}
+
+// Play RANDOM_PLIES random moves from the start position. Returns false if the game ended.
+static bool random_opening(Worker *worker, Position *pos) {
+    pos_set(pos, "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1");
+    zobrist_clear(&worker->stack);
+    zobrist_push(&worker->stack, pos->key);
+
+    for (int ply = 0; ply < RANDOM_PLIES; ply++) {
+        move_t mList[MAX_MOVES];
+        const size_t cnt = (size_t)(gen_all_moves(pos, mList) - mList);
+
+        if (!cnt)
+            return false;
+
+        const Position before = *pos;
+        pos_move(pos, &before, mList[prng(&worker->seed) % cnt]);
+        zobrist_push(&worker->stack, pos->key);
+    }
+
+    return true;
+}
+
+// Play one game, and write its samples (quiet positions only). Result is encoded from white's
+// pov during the game (0 = black wins, 1 = draw, 2 = white wins), and from the side to move's pov
+// in the samples.
+static void play_game(Worker *worker, Buffer *buffer) {
+    Position pos;
+    PackedSample samples[MAX_GAME_PLIES];
+    int sampleCount = 0, result = 1, winPlies = 0;
+
+    while (!random_opening(worker, &pos))
+        ;
+
+    for (int ply = 0; ply < MAX_GAME_PLIES; ply++) {
+        move_t mList[MAX_MOVES];
+
+        if (gen_all_moves(&pos, mList) == mList) {
+            result = !pos.checkers ? 1 : pos.turn == WHITE ? 0 : 2;
+            break;
+        }
+
+        // Draw: 50 move rule (not mated, checked above), repetition, or insufficient material
+        if (pos.rule50 >= 100 || zobrist_repetition(&worker->stack, &pos) ||
+            pos_insufficient_material(&pos))
+            break;
+
+        move_t pv[MAX_PLY + 1];
+        const int score = search_solo(worker, &pos, &GameLimits, pv);
+
+        // Adjudicate a win when the score stays decisive for the same side
+        const int whiteScore = pos.turn == WHITE ? score : -score;
+
+        if (abs(whiteScore) < WIN_SCORE)
+            winPlies = 0;
+        else if (whiteScore > 0)
+            winPlies = max(winPlies, 0) + 1;
+        else
+            winPlies = min(winPlies, 0) - 1;
+
+        if (abs(winPlies) >= WIN_PLIES) {
+            result = winPlies > 0 ? 2 : 0;
+            break;
+        }
+
+        // Record quiet positions only: the search score is not a reliable static label otherwise
+        if (!pos.checkers && !pos_move_is_capture(&pos, pv[0]) && !is_mate_score(score)) {
+            pos_pack(&pos, &samples[sampleCount].pos);
+            samples[sampleCount++].eval = (int16_t)(score / 2);
+        }
+
+        const Position before = pos;
+        pos_move(&pos, &before, pv[0]);
+        zobrist_push(&worker->stack, pos.key);
+    }
+
+    for (int i = 0; i < sampleCount; i++) {
+        samples[i].result = (uint8_t)(samples[i].pos.turn == WHITE ? result : 2 - result);
+
+        if (Binary)
+            buffer_write(buffer, &samples[i], sizeof(PackedSample));
+        else {
+            char fen[MAX_FEN], line[MAX_FEN + 16];
+            pos_unpack(&pos, &samples[i].pos);
+            pos_get(&pos, fen);
+            const int len = sprintf(line, "%s,%d,%d\n", fen, samples[i].eval, samples[i].result);
+            buffer_write(buffer, line, (size_t)len);
+        }
+    }
+
+    SamplesDone += (uint64_t)sampleCount;
+}
+
+static void *datagen_posix(void *_worker) {
+    Worker *worker = _worker;
+    Buffer *buffer = malloc(sizeof(Buffer));
+    buffer->size = 0;
+
+    // Each thread uses its own partition of the hash table, cleared before each game
+    worker->hash = hash_partition((size_t)(worker - Workers), WorkersCount);
+
+    while (atomic_fetch_add(&GamesStarted, 1) < GamesTotal) {
+        hash_clear_partition(&worker->hash);
+        play_game(worker, buffer);
+
+        const uint64_t done = ++GamesDone;
+
+        if (done % 100 == 0) {
+            mtx_lock(&OutMtx);
+            printf("games %" PRIu64 ", samples %" PRIu64 "\n", done, (uint64_t)SamplesDone);
+            mtx_unlock(&OutMtx);
+        }
+    }
+
+    buffer_flush(buffer);
+    free(buffer);
+    return NULL;
+}
+
+void datagen(const char *fileName, uint64_t games, int depth, uint64_t nodes) {
+    const char *ext = strrchr(fileName, '.');
+    Binary = ext && !strcmp(ext, ".bin");
+    Out = fopen(fileName, Binary ? "wb" : "w");
+
+    if (!Out) {
+        printf("cannot open '%s'\n", fileName);
+        return;
+    }
+
+    mtx_init(&OutMtx, mtx_plain);
+    GameLimits = (Limits){.depth = depth, .nodes = nodes};
+    GamesTotal = games;
+    GamesStarted = GamesDone = SamplesDone = 0;
+    Contempt = 0; // draws should be labelled as such
+
+    const int64_t start = system_msec();
+    pthread_t threads[WorkersCount];
+
+    for (size_t i = 0; i < WorkersCount; i++)
+        pthread_create(&threads[i], NULL, datagen_posix, &Workers[i]);
+
+    for (size_t i = 0; i < WorkersCount; i++)
+        pthread_join(threads[i], NULL);
+
+    fclose(Out);
+    mtx_destroy(&OutMtx);
+
+    const int64_t elapsed = system_msec() - start;
+    printf("games   : %" PRIu64 "\n", (uint64_t)GamesDone);
+    printf("samples : %" PRIu64 "\n", (uint64_t)SamplesDone);
+    printf("time    : %" PRId64 "ms\n", elapsed);
+    printf("speed   : %.0f samples/s\n", (double)SamplesDone * 1000.0 / (double)max(elapsed, 1));
+}
@@ -0,0 +1,20 @@
+/*
+ * Demolito, a UCI chess engine. Copyright 2015-2020 lucasart.
+ *
+ * Demolito is free software: you can redistribute it and/or modify it under the terms of the GNU
+ * General Public License as published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * Demolito is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with this program. If
+ * not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+#include <inttypes.h>
+
+// Play self-play games concurrently, one per Worker, and write quiet positions, with their search
+// score and the game result, to fileName: binary format if it ends with ".bin", CSV otherwise.
+void datagen(const char *fileName, uint64_t games, int depth, uint64_t nodes);
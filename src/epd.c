@@ -0,0 +1,276 @@
+/*
+ * Demolito, a UCI chess engine. Copyright 2015-2020 lucasart.
+ *
+ * Demolito is free software: you can redistribute it and/or modify it under the terms of the GNU
+ * General Public License as published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * Demolito is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with this program. If
+ * not, see <http://www.gnu.org/licenses/>.
+ */
+#include "epd.h"
+#include "bitboard.h"
+#include "gen.h"
+#include "htable.h"
+#include "platform.h"
+#include "workers.h"
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Legal move of pos matching str, in SAN (eg. "Nbxd7+", "exd8=Q", "O-O") or UCI notation. Returns 0
+// if there is none.
+static move_t parse_move(const Position *pos, const char *str) {
+    move_t mList[MAX_MOVES];
+    const move_t *end = gen_all_moves(pos, mList);
+    char san[8] = "", uci[6];
+    int len = 0;
+
+    // Strip captures, checks, promotion signs and annotations
+    for (const char *c = str; *c && len < 7; c++)
+        if (!strchr("x+#=!?", *c))
+            san[len++] = *c;
+
+    san[len] = '\0';
+
+    const bool castling = !strncmp(san, "O-O", 3) || !strncmp(san, "0-0", 3);
+    const bool queenSide = castling && len == 5;
+    const int piece =
+        castling ? KING : strchr("NBRQK", san[0]) ? (int)(strchr("NBRQK", san[0]) - "NBRQK") : PAWN;
+    const int prom = piece == PAWN && len >= 3 && strchr("NBRQ", san[len - 1])
+                         ? (int)(strchr("NBRQ", san[len - 1]) - "NBRQ")
+                         : NB_PIECE;
+
+    // Destination square, preceded by optional disambiguation (file and/or rank of departure)
+    const int destEnd = len - (prom != NB_PIECE);
+    const int destBegin = destEnd - 2, disambBegin = piece != PAWN;
+    const int to = !castling && destBegin >= 0 ? string_to_square(&san[destBegin]) : NB_SQUARE;
+
+    for (const move_t *m = mList; m != end; m++) {
+        const int from = move_from(*m);
+        pos_move_to_string(pos, *m, uci);
+
+        if (!strcmp(uci, str))
+            return *m;
+
+        if (pos->pieceOn[from] != piece)
+            continue;
+
+        if (castling) {
+            // Castling moves are encoded as king captures own rook
+            if (bb_test(pos->byColor[pos->turn], move_to(*m)) &&
+                (file_of(move_to(*m)) < file_of(from)) == queenSide)
+                return *m;
+
+            continue;
+        }
+
+        if (move_to(*m) != to || move_prom(*m) != prom ||
+            bb_test(pos->byColor[pos->turn], move_to(*m)))
+            continue;
+
+        bool match = true;
+
+        for (int i = disambBegin; i < destBegin; i++)
+            match &= 'a' <= san[i] && san[i] <= 'h'   ? file_of(from) == san[i] - 'a'
+                     : '1' <= san[i] && san[i] <= '8' ? rank_of(from) == san[i] - '1'
+                                                      : false;
+
+        if (match)
+            return *m;
+    }
+
+    return 0;
+}
+
+bool epd_parse(EpdEntry *e, const char *line) {
+    char buf[1024], fen[MAX_FEN] = "";
+    char *linePos = NULL, *token = NULL;
+    strncpy(buf, line, sizeof(buf) - 1);
+    buf[sizeof(buf) - 1] = '\0';
+
+    *e = (EpdEntry){0};
+
+    for (int i = 0; i < 4; i++) {
+        if (!(token = strtok_r(i ? NULL : buf, " \n", &linePos)))
+            return false;
+
+        strcat(strcat(fen, token), " ");
+    }
+
+    // Optional halfmove and fullmove counters
+    char *rest = linePos ? linePos : "";
+    int rule50 = 0, fullMove = 1, n = 0;
+
+    if (sscanf(rest, "%d %d%n", &rule50, &fullMove, &n) == 2 ||
+        sscanf(rest, "%d%n", &rule50, &n) == 1)
+        rest += n;
+
+    sprintf(fen + strlen(fen), "%d %d", rule50, fullMove);
+    pos_set(&e->pos, fen);
+
+    // Opcodes: "opcode operand ... ;"
+    char *opPos = NULL;
+
+    for (char *op = strtok_r(rest, ";", &opPos); op; op = strtok_r(NULL, ";", &opPos)) {
+        char *wordPos = NULL;
+        const char *opcode = strtok_r(op, " \t\n", &wordPos);
+
+        if (!opcode)
+            continue;
+
+        if (!strcmp(opcode, "bm") || !strcmp(opcode, "am")) {
+            const bool bm = opcode[0] == 'b';
+
+            while ((token = strtok_r(NULL, " \t\n", &wordPos))) {
+                const move_t m = parse_move(&e->pos, token);
+                int *count = bm ? &e->bmCount : &e->amCount;
+
+                if (m && *count < MAX_EPD_MOVES)
+                    (bm ? e->bm : e->am)[(*count)++] = m;
+            }
+        } else if (!strcmp(opcode, "id") && (token = strtok_r(NULL, "\"\n", &wordPos)))
+            strncpy(e->id, token, sizeof(e->id) - 1);
+    }
+
+    return true;
+}
+
+EpdEntry *epd_load(const char *fileName, size_t *count) {
+    FILE *in = fopen(fileName, "r");
+
+    if (!in)
+        return NULL;
+
+    EpdEntry *entries = NULL;
+    char line[1024];
+    *count = 0;
+
+    while (fgets(line, sizeof(line), in)) {
+        entries = realloc(entries, (*count + 1) * sizeof(EpdEntry));
+        *count += epd_parse(&entries[*count], line);
+    }
+
+    fclose(in);
+    return entries;
+}
+
+bool epd_solved(const EpdEntry *e, move_t m) {
+    bool solved = !e->bmCount;
+
+    for (int i = 0; i < e->bmCount; i++)
+        solved |= e->bm[i] == m;
+
+    for (int i = 0; i < e->amCount; i++)
+        solved &= e->am[i] != m;
+
+    return solved;
+}
+
+typedef struct {
+    move_t best;
+    bool solved;
+    int64_t time, solveTime; // ms
+    uint64_t nodes, solveNodes;
+} EpdResult;
+
+static EpdEntry *Entries;
+static EpdResult *Results;
+static size_t EntryCount;
+static atomic_size_t NextEntry;
+static Limits EpdLimits;
+
+static void *epd_posix(void *_worker) {
+    Worker *worker = _worker;
+    move_t pv[MAX_PLY + 1];
+    size_t i;
+
+    // Each thread uses its own partition of the hash table, cleared before each position
+    worker->hash = hash_partition((size_t)(worker - Workers), WorkersCount);
+
+    while ((i = atomic_fetch_add(&NextEntry, 1)) < EntryCount) {
+        const Position *pos = &Entries[i].pos;
+        hash_clear_partition(&worker->hash);
+        zobrist_clear(&worker->stack);
+        zobrist_push(&worker->stack, pos->key);
+
+        const int64_t start = system_msec();
+        search_solo(worker, pos, &EpdLimits, pv);
+
+        Results[i] = (EpdResult){.best = pv[0],
+                                 .solved = epd_solved(&Entries[i], pv[0]),
+                                 .time = system_msec() - start,
+                                 .nodes = worker->nodes,
+                                 .solveTime = worker->bestTime,
+                                 .solveNodes = worker->bestNodes};
+    }
+
+    return NULL;
+}
+
+// Print moves of pos in UCI notation, after label (eg. "bm e2e4 d2d4")
+static void print_moves(const Position *pos, const char *label, const move_t *moves, int count) {
+    char move[6];
+
+    for (int i = 0; i < count; i++) {
+        pos_move_to_string(pos, moves[i], move);
+        printf("%s %s", i ? "" : label, move);
+    }
+}
+
+bool epd_run(const char *fileName, const Limits *limits) {
+    if (!(Entries = epd_load(fileName, &EntryCount)))
+        return false;
+
+    Results = malloc(EntryCount * sizeof(EpdResult));
+    EpdLimits = *limits;
+    NextEntry = 0;
+
+    const int64_t start = system_msec();
+    pthread_t threads[WorkersCount];
+
+    for (size_t i = 0; i < WorkersCount; i++)
+        pthread_create(&threads[i], NULL, epd_posix, &Workers[i]);
+
+    for (size_t i = 0; i < WorkersCount; i++)
+        pthread_join(threads[i], NULL);
+
+    const int64_t elapsed = system_msec() - start;
+    int solved = 0;
+    int64_t solveTime = 0;
+    uint64_t solveNodes = 0;
+
+    for (size_t i = 0; i < EntryCount; i++) {
+        const EpdResult *r = &Results[i];
+        char move[6];
+        pos_move_to_string(&Entries[i].pos, r->best, move);
+        printf("%4zu %-16s %-5s ", i + 1, Entries[i].id, move);
+
+        if (r->solved) {
+            solved++;
+            solveTime += r->solveTime;
+            solveNodes += r->solveNodes;
+            printf("solved in %" PRId64 "ms, %" PRIu64 " nodes\n", r->solveTime, r->solveNodes);
+        } else {
+            // Compare with the expected moves, after searching for the whole time or nodes limit
+            printf("failed (");
+            print_moves(&Entries[i].pos, "bm", Entries[i].bm, Entries[i].bmCount);
+            print_moves(&Entries[i].pos, Entries[i].bmCount ? "; am" : "am", Entries[i].am,
+                        Entries[i].amCount);
+            printf(") in %" PRId64 "ms, %" PRIu64 " nodes\n", r->time, r->nodes);
+        }
+    }
+
+    printf("solved : %d/%zu\n", solved, EntryCount);
+    printf("time to solve  : %.0fms (mean of solved)\n", (double)solveTime / max(solved, 1));
+    printf("nodes to solve : %.0f (mean of solved)\n", (double)solveNodes / max(solved, 1));
+    printf("time  : %" PRId64 "ms\n", elapsed);
+
+    free(Results);
+    free(Entries);
+    return true;
+}
@@ -0,0 +1,43 @@
+/*
+ * Demolito, a UCI chess engine. Copyright 2015-2020 lucasart.
+ *
+ * Demolito is free software: you can redistribute it and/or modify it under the terms of the GNU
+ * General Public License as published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * Demolito is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with this program. If
+ * not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+#include "position.h"
+#include "search.h"
+
+enum { MAX_EPD_MOVES = 8 };
+
+// Test position, with its best moves (bm) and moves to avoid (am)
+typedef struct {
+    Position pos;
+    char id[32];
+    move_t bm[MAX_EPD_MOVES], am[MAX_EPD_MOVES];
+    int bmCount, amCount;
+} EpdEntry;
+
+// Parse an EPD line: the 4 FEN fields, optionally followed by the halfmove and fullmove counters
+// (so FEN lines are also accepted), then opcodes terminated by ';'. bm and am moves are in SAN (or
+// UCI notation). Returns false if the line has no position.
+bool epd_parse(EpdEntry *e, const char *line);
+
+// Read all positions of an EPD file (count of them in *count), or return NULL if it can't be read
+EpdEntry *epd_load(const char *fileName, size_t *count);
+
+// The best move is one of the bm moves (if any), and none of the am moves
+bool epd_solved(const EpdEntry *e, move_t m);
+
+// Search all positions of an EPD file with limits (nodes or movetime), one solo search per Worker
+// running concurrently, each on its own hash partition. Print the result of each position, and the
+// number solved. Returns false if the file can't be read.
+bool epd_run(const char *fileName, const Limits *limits);
@@ -20,3 +20,7 @@ extern double Noise;
 
 void eval_init(void);
 int evaluate(Worker *worker, const Position *pos);
+
+// Same, but may return a cheaper estimate when that estimate is far outside [alpha, beta], in which
+// case *lazy is set (lazy eval)
+int evaluate_lazy(Worker *worker, const Position *pos, int alpha, int beta, bool *lazy);
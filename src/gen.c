@@ -32,16 +32,45 @@ static move_t *serialize_pawn_moves(bitboard_t pawns, int shift, move_t *mList)
     return mList;
 }
 
-static move_t *gen_all_moves(const Position *pos, move_t *mList) {
-    if (pos->checkers)
-        return gen_check_escapes(pos, mList, true);
-    else {
-        move_t *m = mList;
-        m = gen_pawn_moves(pos, m, ~pos->byColor[pos->turn], true);
-        m = gen_piece_moves(pos, m, ~pos->byColor[pos->turn], true);
-        m = gen_castling_moves(pos, m);
-        return m;
+// Remove pawns that can't move by shift, because they're pinned and would leave the pin ray
+static bitboard_t unpinned_pawns(const Position *pos, bitboard_t pawns, int shift) {
+    bitboard_t pinned = pawns & pos->pins;
+
+    if (pinned) {
+        const int king = pos_king_square(pos, pos->turn);
+
+        while (pinned) {
+            const int from = bb_pop_lsb(&pinned);
+
+            if (!bb_test(Ray[king][from], from + shift))
+                bb_clear(&pawns, from);
+        }
     }
+
+    return pawns;
+}
+
+// En-passant capture from 'from' is illegal if it exposes our king through the captured pawn
+static bool ep_is_legal(const Position *pos, int from) {
+    const int us = pos->turn, them = opposite(us);
+    const int king = pos_king_square(pos, us), to = pos->epSquare;
+    bitboard_t occ = pos_pieces(pos);
+    bb_clear(&occ, from);
+    bb_set(&occ, to);
+    bb_clear(&occ, to + push_inc(them));
+    return !(bb_rook_attacks(king, occ) & pos_pieces_cpp(pos, them, ROOK, QUEEN)) &&
+           !(bb_bishop_attacks(king, occ) & pos_pieces_cpp(pos, them, BISHOP, QUEEN));
+}
+
+// Pawn captures by shift, excluding illegal en-passant
+static bitboard_t pawn_captures(const Position *pos, bitboard_t pawns, int shift) {
+    pawns = unpinned_pawns(pos, pawns, shift);
+
+    if (pos->epSquare < NB_SQUARE && bb_test(pawns, pos->epSquare - shift) &&
+        !ep_is_legal(pos, pos->epSquare - shift))
+        bb_clear(&pawns, pos->epSquare - shift);
+
+    return pawns;
 }
 
 move_t *gen_pawn_moves(const Position *pos, move_t *mList, bitboard_t filter, bool subPromotions) {
@@ -55,20 +84,20 @@ move_t *gen_pawn_moves(const Position *pos, move_t *mList, bitboard_t filter, bo
 
     // Left captures
     bitboard_t b = nonPromotingPawns & ~File[FILE_A] & bb_shift(capturable, -(push + LEFT));
-    mList = serialize_pawn_moves(b, push + LEFT, mList);
+    mList = serialize_pawn_moves(pawn_captures(pos, b, push + LEFT), push + LEFT, mList);
 
     // Right captures
     b = nonPromotingPawns & ~File[FILE_H] & bb_shift(capturable, -(push + RIGHT));
-    mList = serialize_pawn_moves(b, push + RIGHT, mList);
+    mList = serialize_pawn_moves(pawn_captures(pos, b, push + RIGHT), push + RIGHT, mList);
 
     // Single pushes
     b = nonPromotingPawns & bb_shift(~pos_pieces(pos) & filter, -push);
-    mList = serialize_pawn_moves(b, push, mList);
+    mList = serialize_pawn_moves(unpinned_pawns(pos, b, push), push, mList);
 
     // Double pushes
     b = nonPromotingPawns & Rank[relative_rank(us, RANK_2)] & bb_shift(~pos_pieces(pos), -push) &
         bb_shift(~pos_pieces(pos) & filter, -2 * push);
-    mList = serialize_pawn_moves(b, 2 * push, mList);
+    mList = serialize_pawn_moves(unpinned_pawns(pos, b, 2 * push), 2 * push, mList);
 
     // ** Promotions **
     bitboard_t promotingPawns = pos_pieces_cp(pos, us, PAWN) & Rank[relative_rank(us, RANK_7)];
@@ -82,6 +111,9 @@ move_t *gen_pawn_moves(const Position *pos, move_t *mList, bitboard_t filter, bo
         if (bb_test(filter & ~pos_pieces(pos), from + push))
             bb_set(&targets, from + push);
 
+        if (bb_test(pos->pins, from))
+            targets &= Ray[pos_king_square(pos, us)][from];
+
         // Generate promotions
         while (targets) {
             const int to = bb_pop_lsb(&targets);
@@ -98,17 +130,15 @@ move_t *gen_pawn_moves(const Position *pos, move_t *mList, bitboard_t filter, bo
 }
 
 move_t *gen_piece_moves(const Position *pos, move_t *mList, bitboard_t filter, bool kingMoves) {
-    const int us = pos->turn;
+    const int us = pos->turn, king = pos_king_square(pos, us);
     int from;
 
     // King moves
-    if (kingMoves) {
-        from = pos_king_square(pos, us);
-        mList = serialize_moves(from, KingAttacks[from] & filter & ~pos->attacked, mList);
-    }
+    if (kingMoves)
+        mList = serialize_moves(king, KingAttacks[king] & filter & ~pos->attacked, mList);
 
-    // Knight moves
-    bitboard_t knights = pos_pieces_cp(pos, us, KNIGHT);
+    // Knight moves (a pinned knight can't move)
+    bitboard_t knights = pos_pieces_cp(pos, us, KNIGHT) & ~pos->pins;
 
     while (knights) {
         from = bb_pop_lsb(&knights);
@@ -120,7 +150,9 @@ move_t *gen_piece_moves(const Position *pos, move_t *mList, bitboard_t filter, b
 
     while (rookMovers) {
         from = bb_pop_lsb(&rookMovers);
-        mList = serialize_moves(from, bb_rook_attacks(from, pos_pieces(pos)) & filter, mList);
+        const bitboard_t pinRay = bb_test(pos->pins, from) ? Ray[king][from] : ~0ULL;
+        mList =
+            serialize_moves(from, bb_rook_attacks(from, pos_pieces(pos)) & filter & pinRay, mList);
     }
 
     // Bishop moves
@@ -128,7 +160,9 @@ move_t *gen_piece_moves(const Position *pos, move_t *mList, bitboard_t filter, b
 
     while (bishopMovers) {
         from = bb_pop_lsb(&bishopMovers);
-        mList = serialize_moves(from, bb_bishop_attacks(from, pos_pieces(pos)) & filter, mList);
+        const bitboard_t pinRay = bb_test(pos->pins, from) ? Ray[king][from] : ~0ULL;
+        mList = serialize_moves(from, bb_bishop_attacks(from, pos_pieces(pos)) & filter & pinRay,
+                                mList);
     }
 
     return mList;
@@ -145,8 +179,9 @@ move_t *gen_castling_moves(const Position *pos, move_t *mList) {
         const int kto = square_from(rank_of(rook), rook > king ? FILE_G : FILE_C);
         const int rto = square_from(rank_of(rook), rook > king ? FILE_F : FILE_D);
 
+        // King can't move through an attacked square, and rook can't be pinned (Chess960)
         if (bb_count((Segment[king][kto] | Segment[rook][rto]) & pos_pieces(pos)) == 2 &&
-            !(pos->attacked & Segment[king][kto]))
+            !(pos->attacked & Segment[king][kto]) && !bb_test(pos->pins, rook))
             *mList++ = move_build(king, rook, NB_PIECE);
     }
 
@@ -184,61 +219,14 @@ move_t *gen_check_escapes(const Position *pos, move_t *mList, bool subPromotions
     return mList;
 }
 
-bool gen_is_legal(const Position *pos, bitboard_t pins, move_t m) {
-    const int from = move_from(m), to = move_to(m);
-    const int piece = pos->pieceOn[from];
-    const int king = pos_king_square(pos, pos->turn);
-
-    if (piece == KING) {
-        if (bb_test(pos->byColor[pos->turn], to)) {
-            // Castling: king can't move through attacked square, and rook can't be pinned
-            assert(pos->pieceOn[to] == ROOK);
-            return !bb_test(pins, to);
-        } else
-            // Normal king move: do not land on an attacked square (already filtered at generation)
-            return true;
-    } else {
-        // Normal case: illegal if pinned, and moves out of pin-ray
-        if (bb_test(pins, from) && !bb_test(Ray[king][from], to))
-            return false;
-
-        // En-passant special case: also illegal if self-check through the en-passant captured pawn
-        if (to == pos->epSquare && piece == PAWN) {
-            const int us = pos->turn, them = opposite(us);
-            bitboard_t occ = pos_pieces(pos);
-            bb_clear(&occ, from);
-            bb_set(&occ, to);
-            bb_clear(&occ, to + push_inc(them));
-            return !(bb_rook_attacks(king, occ) & pos_pieces_cpp(pos, them, ROOK, QUEEN)) &&
-                   !(bb_bishop_attacks(king, occ) & pos_pieces_cpp(pos, them, BISHOP, QUEEN));
-        } else
-            return true;
-    }
-}
-
-uint64_t gen_perft(const Position *pos, int depth, int ply) {
-    if (depth <= 0)
-        return 1;
-
-    const bitboard_t pins = calc_pins(pos);
-    uint64_t result = 0;
-    move_t mList[MAX_MOVES], *end = gen_all_moves(pos, mList);
-
-    for (move_t *m = mList; m != end; m++) {
-        if (!gen_is_legal(pos, pins, *m))
-            continue;
-
-        Position after;
-        pos_move(&after, pos, *m);
-        const uint64_t subTree = gen_perft(&after, depth - 1, ply + 1);
-        result += subTree;
-
-        if (!ply) {
-            char str[6];
-            pos_move_to_string(pos, *m, str);
-            printf("%s\t%" PRIu64 "\n", str, subTree);
-        }
+move_t *gen_all_moves(const Position *pos, move_t *mList) {
+    if (pos->checkers)
+        return gen_check_escapes(pos, mList, true);
+    else {
+        move_t *m = mList;
+        m = gen_pawn_moves(pos, m, ~pos->byColor[pos->turn], true);
+        m = gen_piece_moves(pos, m, ~pos->byColor[pos->turn], true);
+        m = gen_castling_moves(pos, m);
+        return m;
     }
-
-    return result;
 }
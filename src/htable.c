@@ -15,11 +15,11 @@
 #include "htable.h"
 #include "platform.h"
 #include "search.h"
+#include <limits.h>
 #include <stdlib.h>
 #include <string.h>
 
-static HashEntry *HashTable = NULL;
-static size_t HashCount = 0;
+static HashTable Hash = {{NULL}, 0, false};
 
 unsigned hashDate = 0;
 
@@ -45,28 +45,63 @@ static int score_from_hash(int hashScore, int ply) {
     return hashScore;
 }
 
-static __attribute__((destructor)) void hash_free(void) { free(HashTable); }
+static __attribute__((destructor)) void hash_free(void) { free(Hash.entries); }
 
-void hash_prepare(uint64_t hashMB) {
+static size_t hash_slot_size(const HashTable *ht) {
+    return ht->compact ? sizeof(HashBucket) : sizeof(HashEntry);
+}
+
+void hash_prepare(uint64_t hashMB, bool compact) {
     assert(bb_count(hashMB) == 1); // must be a power of 2
 
-    HashCount = (hashMB << 20) / sizeof(HashEntry);
-    HashTable = realloc(HashTable, HashCount * sizeof(HashEntry));
+    Hash.compact = compact;
+    Hash.count = (hashMB << 20) / hash_slot_size(&Hash);
 
-    // All 64-bit malloc() implementations should return 16-byte aligned memory. We want this for
-    // performance, to ensure that no HashEntry sits across two cache lines.
-    assert((uintptr_t)HashTable % sizeof(HashEntry) == 0);
+    // Align on cache lines, so that no HashEntry or HashBucket sits across two of them
+    free(Hash.entries);
+    Hash.entries = aligned_alloc(64, Hash.count * hash_slot_size(&Hash));
 
     hash_clear();
 }
 
 void hash_clear(void) {
-    memset(HashTable, 0, HashCount * sizeof(HashEntry));
+    hash_clear_partition(&Hash);
     hashDate = 0;
 }
 
-HashEntry hash_read(uint64_t key, int ply) {
-    HashEntry e = HashTable[key & (HashCount - 1)];
+// Split the hash table into 'count' disjoint partitions, and return the idx-th one. Partitions have
+// a power of 2 size, so some entries are left unused when count is not a power of 2.
+HashTable hash_partition(size_t idx, size_t count) {
+    assert(idx < count && count <= Hash.count);
+    const size_t size = 1ULL << bb_msb(Hash.count / count);
+    HashTable ht = {.count = size, .compact = Hash.compact};
+
+    if (Hash.compact)
+        ht.buckets = Hash.buckets + idx * size;
+    else
+        ht.entries = Hash.entries + idx * size;
+
+    return ht;
+}
+
+void hash_clear_partition(const HashTable *ht) {
+    memset(ht->entries, 0, ht->count * hash_slot_size(ht));
+}
+
+HashEntry hash_read(const HashTable *ht, uint64_t key, int ply) {
+    HashEntry e = {0};
+
+    if (ht->compact) {
+        const HashBucket *bucket = &ht->buckets[key & (ht->count - 1)];
+
+        // Empty entries (data = 0) never match, even for keys whose top 16 bits are zero
+        for (int i = 0; i < BUCKET_ENTRIES; i++)
+            if (bucket->entries[i].key == (uint16_t)(key >> 48) && bucket->entries[i].data) {
+                e = (HashEntry){.key = key, .data = bucket->entries[i].data};
+                break;
+            }
+    } else
+        e = ht->entries[key & (ht->count - 1)];
 
     if (e.key == key)
         e.score = (int16_t)score_from_hash(e.score, ply);
@@ -76,12 +111,47 @@ HashEntry hash_read(uint64_t key, int ply) {
     return e;
 }
 
-void hash_write(uint64_t key, HashEntry *e, int ply) {
-    HashEntry *slot = &HashTable[key & (HashCount - 1)];
+// Compact layout: write to the entry with the same key if any, otherwise replace the least valuable
+// entry of the bucket (older search first, then lower depth).
+static void hash_write_compact(const HashTable *ht, uint64_t key, HashEntry *e) {
+    HashBucket *bucket = &ht->buckets[key & (ht->count - 1)];
+    const uint16_t key16 = (uint16_t)(key >> 48);
+    CompactEntry *slot = NULL;
+    int minValue = INT_MAX;
+
+    for (int i = 0; i < BUCKET_ENTRIES; i++) {
+        const HashEntry old = {.data = bucket->entries[i].data};
+
+        if (bucket->entries[i].key == key16 && old.data) {
+            if (e->date != old.date || e->depth >= old.depth)
+                bucket->entries[i] = (CompactEntry){.key = key16, .data = e->data};
 
+            return;
+        }
+
+        const int value = (old.date == e->date) * 256 + old.depth;
+
+        if (value < minValue) {
+            minValue = value;
+            slot = &bucket->entries[i];
+        }
+    }
+
+    *slot = (CompactEntry){.key = key16, .data = e->data};
+}
+
+void hash_write(const HashTable *ht, uint64_t key, HashEntry *e, int ply) {
     e->date = (uint8_t)hashDate;
     assert(e->date == hashDate % 64);
 
+    if (ht->compact) {
+        e->score = (int16_t)score_to_hash(e->score, ply);
+        hash_write_compact(ht, key, e);
+        return;
+    }
+
+    HashEntry *slot = &ht->entries[key & (ht->count - 1)];
+
     if (e->date != slot->date || e->depth >= slot->depth) {
         e->score = (int16_t)score_to_hash(e->score, ply);
         e->key = key;
@@ -89,13 +159,24 @@ void hash_write(uint64_t key, HashEntry *e, int ply) {
     }
 }
 
-void hash_prefetch(uint64_t key) { __builtin_prefetch(&HashTable[key & (HashCount - 1)]); }
+void hash_prefetch(const HashTable *ht, uint64_t key) {
+    if (ht->compact)
+        __builtin_prefetch(&ht->buckets[key & (ht->count - 1)]);
+    else
+        __builtin_prefetch(&ht->entries[key & (ht->count - 1)]);
+}
 
 int hash_permille(void) {
     int result = 0;
 
-    for (int i = 0; i < 1000; i++)
-        result += HashTable[i].key && HashTable[i].date == hashDate % 64;
+    for (int i = 0; i < 1000; i++) {
+        if (Hash.compact) {
+            const CompactEntry *ce = &Hash.buckets[i / BUCKET_ENTRIES].entries[i % BUCKET_ENTRIES];
+            const HashEntry e = {.data = ce->data};
+            result += (ce->key || ce->data) && e.date == hashDate % 64;
+        } else
+            result += Hash.entries[i].key && Hash.entries[i].date == hashDate % 64;
+    }
 
     return result;
 }
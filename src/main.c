@@ -12,50 +12,22 @@
  * You should have received a copy of the GNU General Public License along with this program. If
  * not, see <http://www.gnu.org/licenses/>.
  */
+#include "bench.h"
 #include "bitboard.h"
+#include "datagen.h"
+#include "epd.h"
 #include "eval.h"
 #include "htable.h"
+#include "perft.h"
 #include "platform.h"
 #include "position.h"
 #include "search.h"
+#include "util.h"
 #include "uci.h"
 #include "workers.h"
 #include <stdlib.h>
 #include <string.h>
 
-static void bench(int depth) {
-    static const char *fens[] = {
-#include "test.csv"
-        NULL};
-
-    uint64_t nodes = 0;
-    uciChess960 = true;
-
-    lim = (Limits){0};
-    lim.depth = depth;
-
-    int64_t start = system_msec();
-
-    for (int i = 0; fens[i]; i++) {
-        pos_set(&rootPos, fens[i]);
-        zobrist_clear(&rootStack);
-        zobrist_push(&rootStack, rootPos.key);
-
-        puts(fens[i]);
-        nodes += search_go();
-        puts("");
-    }
-
-    if (dbgCnt[0] || dbgCnt[1])
-        printf("dbgCnt[0] = %" PRId64 ", dbgCnt[1] = %" PRId64 "\n", dbgCnt[0], dbgCnt[1]);
-
-    const int64_t elapsed = system_msec() - start;
-
-    printf("time  : %" PRIu64 "ms\n", elapsed);
-    printf("nodes : %" PRIu64 "\n", nodes); // total nodes = functionality signature
-    printf("nps   : %.0f\n", (double)nodes * 1000.0 / (double)max(elapsed, 1)); // avoid div/0
-}
-
 int main(int argc, char **argv) {
     eval_init();
     search_init();
@@ -70,14 +42,97 @@ int main(int argc, char **argv) {
             if (argc > 4)
                 uciHash = 1ULL << bb_msb((uint64_t)atoll(argv[4])); // must be a power of 2
 
+            if (argc > 5)
+                uciPawnHash = (size_t)atoll(argv[5]);
+
             workers_prepare(uciThreads);
-            hash_prepare(uciHash);
+            workers_prepare_pawn_hash(uciPawnHash, uciSharedPawnHash);
+            hash_prepare(uciHash, uciCompactHash);
             bench(depth);
-        } else
-            puts("Syntax: demolito [bench [depth [threads [hash]]]]");
+        } else if (!strcmp(argv[1], "benchstats")) {
+            const int depth = argc > 2 ? atoi(argv[2]) : 10;
+            const int runs = argc > 3 ? atoi(argv[3]) : 5;
+            const size_t workers = argc > 4 ? (size_t)atoll(argv[4]) : 1;
+
+            workers_prepare(workers);
+            hash_prepare(uciHash << bb_msb(2 * workers - 1), uciCompactHash); // uciHash each
+            bench_stats(depth, runs, argc > 5 && !strcmp(argv[5], "csv"));
+        } else if (!strcmp(argv[1], "smpbench")) {
+            const int depth = argc > 2 ? atoi(argv[2]) : 12;
+            const size_t threads = argc > 3 ? (size_t)atoll(argv[3]) : 4;
+
+            if (argc > 4)
+                uciHash = 1ULL << bb_msb((uint64_t)atoll(argv[4])); // must be a power of 2
+
+            hash_prepare(uciHash, uciCompactHash);
+            smp_bench(argc > 5 ? argv[5] : NULL, depth, threads);
+        } else if (!strcmp(argv[1], "epd") && argc > 2) {
+            // Limit: movetime in ms, or nodes with an 'n' suffix (eg. 100000n)
+            const char *limit = argc > 3 ? argv[3] : "1000";
+            Limits limits = {.depth = MAX_DEPTH};
+
+            if (limit[strlen(limit) - 1] == 'n')
+                limits.nodes = (uint64_t)atoll(limit);
+            else
+                limits.movetime = atoll(limit);
+
+            if (argc > 4)
+                uciThreads = (size_t)atoll(argv[4]);
+
+            workers_prepare(uciThreads);
+            hash_prepare(uciHash << bb_msb(2 * uciThreads - 1), uciCompactHash); // uciHash each
+
+            if (!epd_run(argv[2], &limits)) {
+                printf("cannot open '%s'\n", argv[2]);
+                return 1;
+            }
+        } else if (!strcmp(argv[1], "datagen") && argc > 2) {
+            const uint64_t games = argc > 3 ? (uint64_t)atoll(argv[3]) : 1000;
+            const int depth = argc > 4 ? atoi(argv[4]) : 8;
+            const uint64_t nodes = argc > 5 ? (uint64_t)atoll(argv[5]) : 0;
+
+            if (argc > 6)
+                uciThreads = (size_t)atoll(argv[6]);
+
+            if (argc > 7)
+                uciHash = 1ULL << bb_msb((uint64_t)atoll(argv[7])); // must be a power of 2
+
+            workers_prepare(uciThreads);
+            hash_prepare(uciHash, uciCompactHash);
+            datagen(argv[2], games, depth ? depth : MAX_DEPTH, nodes);
+        } else if (!strcmp(argv[1], "perft") && argc > 2) {
+            const int depth = atoi(argv[2]);
+            const size_t threads = argc > 3 ? (size_t)atoll(argv[3]) : uciThreads;
+            const size_t hashMB = argc > 4 ? (size_t)atoll(argv[4]) : 64;
+
+            const char *fen =
+                argc > 5 ? argv[5] : "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+
+            perft_bench(fen, depth, threads, hashMB);
+        } else if (!strcmp(argv[1], "perftsuite") && argc > 2) {
+            const size_t threads = argc > 3 ? (size_t)atoll(argv[3]) : uciThreads;
+            const size_t hashMB = argc > 4 ? (size_t)atoll(argv[4]) : 64;
+            return perft_suite(argv[2], threads, hashMB) ? 0 : 1;
+        } else if (!strcmp(argv[1], "sliderbench"))
+            slider_bench(argc > 2 ? (uint64_t)atoll(argv[2]) : 100000000);
+        else if (!strcmp(argv[1], "hashbench"))
+            hash_bench(argc > 2 ? 1ULL << bb_msb((uint64_t)atoll(argv[2])) : 64);
+        else if (!strcmp(argv[1], "positionbench"))
+            position_bench(argc > 2 ? atoi(argv[2]) : 300, argc > 3 ? atoi(argv[3]) : 10);
+        else
+            puts("Syntax: demolito [bench [depth [threads [hash [pawnhash]]]]]\n"
+                 "        demolito benchstats [depth [runs [workers [json|csv]]]]\n"
+                 "        demolito smpbench [depth [threads [hash [epdfile]]]]\n"
+                 "        demolito epd <file> [movetime|<nodes>n [concurrency]]\n"
+                 "        demolito datagen <file> [games [depth [nodes [threads [hash]]]]]\n"
+                 "        demolito perft <depth> [threads [hash [fen]]]\n"
+                 "        demolito perftsuite <file> [threads [hash]]\n"
+                 "        demolito sliderbench [lookups]\n"
+                 "        demolito hashbench [hash]\n"
+                 "        demolito positionbench [plies [runs]]");
     } else {
         workers_prepare(uciThreads);
-        hash_prepare(uciHash);
+        hash_prepare(uciHash, uciCompactHash);
         uci_loop();
     }
 }
@@ -0,0 +1,279 @@
+/*
+ * Demolito, a UCI chess engine. Copyright 2015-2020 lucasart.
+ *
+ * Demolito is free software: you can redistribute it and/or modify it under the terms of the GNU
+ * General Public License as published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * Demolito is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with this program. If
+ * not, see <http://www.gnu.org/licenses/>.
+ */
+#include "perft.h"
+#include "bitboard.h"
+#include "gen.h"
+#include "platform.h"
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Lockless: keyXor = key ^ data, so that torn writes from another thread are detected
+typedef struct {
+    uint64_t keyXor, data; // data = leaf count << 8 | depth
+} PerftEntry;
+
+static PerftEntry *PerftHash;
+static size_t PerftHashMask;
+
+static const Position *RootPos;
+static move_t RootMoves[MAX_MOVES];
+static uint64_t RootCounts[MAX_MOVES];
+static int RootDepth, RootMoveCount;
+static atomic_int NextRootMove;
+
+static void perft_hash_alloc(size_t hashMB) {
+    PerftHashMask = hashMB ? (1ULL << bb_msb((hashMB << 20) / sizeof(PerftEntry))) - 1 : 0;
+    PerftHash = hashMB ? calloc(PerftHashMask + 1, sizeof(PerftEntry)) : NULL;
+}
+
+static void perft_hash_free(void) {
+    free(PerftHash);
+    PerftHash = NULL;
+}
+
+static uint64_t perft_rec(const Position *pos, int depth) {
+    move_t mList[MAX_MOVES], *end = gen_all_moves(pos, mList);
+
+    // Bulk counting: leaves are the legal moves, no need to play them
+    if (depth == 1)
+        return (uint64_t)(end - mList);
+
+    uint64_t result = 0;
+    PerftEntry *slot = PerftHash ? &PerftHash[pos->key & PerftHashMask] : NULL;
+
+    if (slot) {
+        const PerftEntry pe = *slot;
+
+        if ((pe.keyXor ^ pe.data) == pos->key && (int)(pe.data & 0xff) == depth)
+            return pe.data >> 8;
+    }
+
+    for (move_t *m = mList; m != end; m++) {
+        Position after;
+        pos_move(&after, pos, *m);
+        result += perft_rec(&after, depth - 1);
+    }
+
+    if (slot) {
+        const uint64_t data = result << 8 | (uint64_t)depth;
+        *slot = (PerftEntry){.keyXor = pos->key ^ data, .data = data};
+    }
+
+    return result;
+}
+
+static void *perft_posix(void *dummy) {
+    (void)dummy; // silence compiler warning (unused variable)
+    int i;
+
+    while ((i = atomic_fetch_add(&NextRootMove, 1)) < RootMoveCount) {
+        Position after;
+        pos_move(&after, RootPos, RootMoves[i]);
+        RootCounts[i] = RootDepth > 1 ? perft_rec(&after, RootDepth - 1) : 1;
+    }
+
+    return NULL;
+}
+
+uint64_t perft(const Position *pos, int depth, size_t threads, size_t hashMB, bool div) {
+    if (depth <= 0)
+        return 1;
+
+    RootMoveCount = (int)(gen_all_moves(pos, RootMoves) - RootMoves);
+
+    perft_hash_alloc(hashMB);
+
+    RootPos = pos;
+    RootDepth = depth;
+    NextRootMove = 0;
+
+    threads = max(threads, 1);
+    pthread_t workers[threads];
+
+    for (size_t i = 0; i < threads; i++)
+        pthread_create(&workers[i], NULL, perft_posix, NULL);
+
+    for (size_t i = 0; i < threads; i++)
+        pthread_join(workers[i], NULL);
+
+    perft_hash_free();
+
+    uint64_t result = 0;
+
+    for (int i = 0; i < RootMoveCount; i++) {
+        result += RootCounts[i];
+
+        if (div) {
+            char str[6];
+            pos_move_to_string(pos, RootMoves[i], str);
+            printf("%s\t%" PRIu64 "\n", str, RootCounts[i]);
+        }
+    }
+
+    return result;
+}
+
+enum { SUITE_MAX_DEPTH = 8 };
+
+typedef struct {
+    char fen[128];
+    uint64_t expected[SUITE_MAX_DEPTH + 1]; // expected[depth], 0 if not given
+    atomic_uint_fast64_t counts[SUITE_MAX_DEPTH + 1];
+} SuiteEntry;
+
+// Unit of work: one root move of one entry, at one depth. A single entry can dominate the suite
+// (eg. kiwipete at depth 5), so splitting by root move is what keeps all threads busy.
+typedef struct {
+    int entry, depth;
+    move_t move;
+} SuiteJob;
+
+static SuiteEntry *Suite;
+static int SuiteCount;
+static SuiteJob *Jobs;
+static int JobCount;
+static atomic_int NextJob;
+
+static void *perft_suite_posix(void *dummy) {
+    (void)dummy; // silence compiler warning (unused variable)
+    int i;
+
+    while ((i = atomic_fetch_add(&NextJob, 1)) < JobCount) {
+        const SuiteJob *job = &Jobs[i];
+        Position pos, after;
+        pos_set(&pos, Suite[job->entry].fen);
+        pos_move(&after, &pos, job->move);
+
+        const uint64_t count = job->depth > 1 ? perft_rec(&after, job->depth - 1) : 1;
+        atomic_fetch_add(&Suite[job->entry].counts[job->depth], count);
+    }
+
+    return NULL;
+}
+
+// Jobs for all entries, root moves and depths, deepest first, so that the big jobs are not left
+// for the end
+static void suite_jobs(void) {
+    JobCount = 0;
+
+    for (int depth = SUITE_MAX_DEPTH; depth >= 1; depth--)
+        for (int i = 0; i < SuiteCount; i++)
+            if (Suite[i].expected[depth]) {
+                Position pos;
+                pos_set(&pos, Suite[i].fen);
+                move_t mList[MAX_MOVES];
+                const move_t *end = gen_all_moves(&pos, mList);
+
+                Jobs = realloc(Jobs, (size_t)(JobCount + (end - mList)) * sizeof(SuiteJob));
+
+                for (const move_t *m = mList; m != end; m++)
+                    Jobs[JobCount++] = (SuiteJob){.entry = i, .depth = depth, .move = *m};
+            }
+}
+
+// Parse "fen ;D1 count ;D2 count ..." into se. Returns false if the line has no perft count.
+static bool suite_parse(char *line, SuiteEntry *se) {
+    char *linePos = NULL, *token = strtok_r(line, ";\n", &linePos);
+
+    if (!token || strlen(token) >= sizeof(se->fen))
+        return false;
+
+    *se = (SuiteEntry){0};
+    strcpy(se->fen, token);
+
+    for (size_t n = strlen(se->fen); n && se->fen[n - 1] == ' '; n--)
+        se->fen[n - 1] = '\0';
+    bool found = false;
+
+    while ((token = strtok_r(NULL, ";\n", &linePos))) {
+        int depth;
+        uint64_t count;
+
+        if (sscanf(token, " D%d %" SCNu64, &depth, &count) == 2 && 1 <= depth &&
+            depth <= SUITE_MAX_DEPTH) {
+            se->expected[depth] = count;
+            found = true;
+        }
+    }
+
+    return found;
+}
+
+bool perft_suite(const char *fileName, size_t threads, size_t hashMB) {
+    FILE *in = fopen(fileName, "r");
+
+    if (!in) {
+        printf("cannot open '%s'\n", fileName);
+        return false;
+    }
+
+    char line[1024];
+    SuiteCount = 0;
+
+    while (fgets(line, sizeof line, in)) {
+        Suite = realloc(Suite, (size_t)(SuiteCount + 1) * sizeof(SuiteEntry));
+        SuiteCount += suite_parse(line, &Suite[SuiteCount]);
+    }
+
+    fclose(in);
+
+    suite_jobs();
+    perft_hash_alloc(hashMB);
+    NextJob = 0;
+
+    const int64_t start = system_msec();
+    threads = max(threads, 1);
+    pthread_t workers[threads];
+
+    for (size_t i = 0; i < threads; i++)
+        pthread_create(&workers[i], NULL, perft_suite_posix, NULL);
+
+    for (size_t i = 0; i < threads; i++)
+        pthread_join(workers[i], NULL);
+
+    const int64_t elapsed = system_msec() - start;
+    perft_hash_free();
+
+    uint64_t nodes = 0;
+    int passed = 0;
+
+    for (int i = 0; i < SuiteCount; i++) {
+        const SuiteEntry *se = &Suite[i];
+        int failedDepth = 0;
+
+        for (int depth = 1; depth <= SUITE_MAX_DEPTH; depth++) {
+            nodes += se->counts[depth];
+
+            if (se->counts[depth] != se->expected[depth] && !failedDepth)
+                failedDepth = depth;
+        }
+
+        passed += !failedDepth;
+
+        if (failedDepth)
+            printf("FAIL D%d\t%s\n", failedDepth, se->fen);
+    }
+
+    printf("passed : %d/%d\n", passed, SuiteCount);
+    printf("time   : %" PRId64 "ms\n", elapsed);
+    printf("speed  : %.1f Mnps\n", (double)nodes / 1000.0 / (double)max(elapsed, 1));
+
+    free(Suite);
+    free(Jobs);
+    Suite = NULL;
+    Jobs = NULL;
+    return passed == SuiteCount;
+}
@@ -0,0 +1,25 @@
+/*
+ * Demolito, a UCI chess engine. Copyright 2015-2020 lucasart.
+ *
+ * Demolito is free software: you can redistribute it and/or modify it under the terms of the GNU
+ * General Public License as published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * Demolito is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with this program. If
+ * not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+#include "position.h"
+
+// Count leaves of the full tree (ie. generate all legal moves at each node, no pruning). Root moves
+// are split across threads, and subtree counts are cached in a dedicated hash table of hashMB
+// megabytes (0 = no hash). If div, print the leaf count of each root move.
+uint64_t perft(const Position *pos, int depth, size_t threads, size_t hashMB, bool div);
+
+// Run the perft suite in fileName, with one EPD per line: "fen ;D1 count ;D2 count ...". Positions
+// are split across threads. Print failures, and return true if all counts match.
+bool perft_suite(const char *fileName, size_t threads, size_t hashMB);
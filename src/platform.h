@@ -25,6 +25,13 @@ static inline int64_t system_msec(void) {
     QueryPerformanceFrequency(&f);
     return 1000LL * t.QuadPart / f.QuadPart;
 }
+
+static inline int64_t system_usec(void) {
+    LARGE_INTEGER t, f;
+    QueryPerformanceCounter(&t);
+    QueryPerformanceFrequency(&f);
+    return t.QuadPart / f.QuadPart * 1000000LL + t.QuadPart % f.QuadPart * 1000000LL / f.QuadPart;
+}
 #else
 // Locks
 typedef pthread_mutex_t mtx_t;
@@ -44,4 +51,10 @@ static inline int64_t system_msec(void) {
     clock_gettime(CLOCK_MONOTONIC, &t);
     return t.tv_sec * 1000LL + t.tv_nsec / 1000000;
 }
+
+static inline int64_t system_usec(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1000000LL + t.tv_nsec / 1000;
+}
 #endif
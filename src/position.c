@@ -95,6 +95,27 @@ static bitboard_t attacked_by(const Position *pos, int color) {
     return result;
 }
 
+// Pinned pieces for the side to move
+static bitboard_t calc_pins(const Position *pos) {
+    const int us = pos->turn, them = opposite(us);
+    const int king = pos_king_square(pos, us);
+    bitboard_t pinners = (pos_pieces_cpp(pos, them, ROOK, QUEEN) & bb_rook_attacks(king, 0)) |
+                         (pos_pieces_cpp(pos, them, BISHOP, QUEEN) & bb_bishop_attacks(king, 0));
+    bitboard_t result = 0;
+
+    while (pinners) {
+        const int square = bb_pop_lsb(&pinners);
+        bitboard_t skewered = Segment[king][square] & pos_pieces(pos);
+        bb_clear(&skewered, king);
+        bb_clear(&skewered, square);
+
+        if (!bb_several(skewered) && (skewered & pos->byColor[us]))
+            result |= skewered;
+    }
+
+    return result;
+}
+
 // Helper function used to facorize common tasks, after setting up a position
 static void finish(Position *pos) {
     const int us = pos->turn, them = opposite(us);
@@ -104,6 +125,7 @@ static void finish(Position *pos) {
     pos->checkers = bb_test(pos->attacked, king)
                         ? pos_attackers_to(pos, king, pos_pieces(pos)) & pos->byColor[them]
                         : 0;
+    pos->pins = calc_pins(pos);
 
 #ifndef NDEBUG
     // Verify that byColor[] and byPiece[] do not collide, and are consistent
@@ -339,6 +361,46 @@ void pos_get(const Position *pos, char *fen) {
     sprintf(fen, " %s %d", str, pos->rule50);
 }
 
+void pos_pack(const Position *pos, PackedPos *pp) {
+    *pp = (PackedPos){.occ = pos_pieces(pos),
+                      .turn = (uint8_t)pos->turn,
+                      .epSquare = (uint8_t)pos->epSquare,
+                      .rule50 = (uint8_t)pos->rule50};
+
+    bitboard_t b = pp->occ;
+
+    for (int i = 0; b; i++) {
+        const int square = bb_pop_lsb(&b);
+        const int piece = bb_test(pos->castleRooks, square) ? NB_PIECE : pos->pieceOn[square];
+        pp->pieces[i / 2] |= (uint8_t)((pos_color_on(pos, square) << 3 | piece) << 4 * (i % 2));
+    }
+}
+
+void pos_unpack(Position *pos, const PackedPos *pp) {
+    clear(pos);
+    bitboard_t b = pp->occ;
+
+    for (int i = 0; b; i++) {
+        const int square = bb_pop_lsb(&b);
+        const int nibble = pp->pieces[i / 2] >> 4 * (i % 2) & 15;
+        const int color = nibble >> 3, piece = nibble & 7;
+
+        if (piece == NB_PIECE) {
+            set_square(pos, color, ROOK, square);
+            bb_set(&pos->castleRooks, square);
+        } else
+            set_square(pos, color, piece, square);
+    }
+
+    pos->turn = pp->turn;
+    pos->epSquare = pp->epSquare;
+    pos->rule50 = pp->rule50;
+    pos->key ^= (pos->turn == BLACK ? ZobristTurn : 0) ^ zobrist_castling(pos->castleRooks) ^
+                ZobristEnPassant[pos->epSquare];
+
+    finish(pos);
+}
+
 // Play a move on a position copy (original 'before' is untouched): pos = before + play(m)
 void pos_move(Position *pos, const Position *before, move_t m) {
     *pos = *before;
@@ -484,27 +546,6 @@ bitboard_t pos_attackers_to(const Position *pos, int square, bitboard_t occ) {
            (bb_bishop_attacks(square, occ) & (pos->byPiece[BISHOP] | pos->byPiece[QUEEN]));
 }
 
-// Pinned pieces for the side to move
-bitboard_t calc_pins(const Position *pos) {
-    const int us = pos->turn, them = opposite(us);
-    const int king = pos_king_square(pos, us);
-    bitboard_t pinners = (pos_pieces_cpp(pos, them, ROOK, QUEEN) & bb_rook_attacks(king, 0)) |
-                         (pos_pieces_cpp(pos, them, BISHOP, QUEEN) & bb_bishop_attacks(king, 0));
-    bitboard_t result = 0;
-
-    while (pinners) {
-        const int square = bb_pop_lsb(&pinners);
-        bitboard_t skewered = Segment[king][square] & pos_pieces(pos);
-        bb_clear(&skewered, king);
-        bb_clear(&skewered, square);
-
-        if (!bb_several(skewered) && (skewered & pos->byColor[us]))
-            result |= skewered;
-    }
-
-    return result;
-}
-
 bool pos_move_is_capture(const Position *pos, move_t m) {
     const int from = move_from(m), to = move_to(m);
     return bb_test(pos->byColor[opposite(pos->turn)], to) ||
@@ -553,52 +594,69 @@ move_t pos_string_to_move(const Position *pos, const char *str) {
 }
 
 // Static Exchange Evaluator
-int pos_see(const Position *pos, move_t m) {
-    const int from = move_from(m), to = move_to(m), prom = move_prom(m);
-    int us = pos->turn;
-    bitboard_t occ = pos_pieces(pos);
+// Remove the least valuable attacker (LVA) of color us from occ and attackers, add the x-ray
+// attackers it uncovers, and return its piece
+static int see_pop_lva(const Position *pos, int us, int to, bitboard_t *occ,
+                       bitboard_t *attackers) {
+    const bitboard_t ourAttackers = *attackers & pos->byColor[us];
+    int lva = PAWN;
 
-    // General case
-    int gain[32];
-    int moved = pos->pieceOn[from];
-    gain[0] = PieceValue[pos->pieceOn[to]];
-    bb_clear(&occ, from);
+    if (!(ourAttackers & pos->byPiece[PAWN]))
+        for (lva = KNIGHT; lva <= KING; lva++)
+            if (ourAttackers & pos->byPiece[lva])
+                break;
+
+    bb_clear(occ, bb_lsb(ourAttackers & pos->byPiece[lva]));
 
-    // Special cases
-    if (moved == PAWN) {
+    if (lva == PAWN || lva == BISHOP || lva == QUEEN)
+        *attackers |= bb_bishop_attacks(to, *occ) & (pos->byPiece[BISHOP] | pos->byPiece[QUEEN]);
+
+    if (lva == ROOK || lva == QUEEN)
+        *attackers |= bb_rook_attacks(to, *occ) & (pos->byPiece[ROOK] | pos->byPiece[QUEEN]);
+
+    *attackers &= *occ;
+    return lva;
+}
+
+// Material won by the move itself (captured piece and promotion), and piece standing on 'to' after
+// the move. Removes the moving piece (and the en-passant captured pawn) from occ.
+static int see_first_gain(const Position *pos, move_t m, bitboard_t *occ, int *moved) {
+    const int from = move_from(m), to = move_to(m), prom = move_prom(m);
+    int gain = PieceValue[pos->pieceOn[to]];
+    *moved = pos->pieceOn[from];
+    bb_clear(occ, from);
+
+    if (*moved == PAWN) {
         if (to == pos->epSquare) {
-            bb_clear(&occ, to - push_inc(us));
-            gain[0] = PieceValue[moved];
+            bb_clear(occ, to - push_inc(pos->turn));
+            gain = PieceValue[PAWN];
         } else if (prom < NB_PIECE) {
-            moved = prom;
-            gain[0] += PieceValue[moved] - PieceValue[PAWN];
+            *moved = prom;
+            gain += PieceValue[prom] - PieceValue[PAWN];
         }
     }
 
+    return gain;
+}
+
+int pos_see(const Position *pos, move_t m) {
+    const int to = move_to(m);
+    int us = pos->turn, moved;
+    bitboard_t occ = pos_pieces(pos);
+
+    int gain[32];
+    gain[0] = see_first_gain(pos, m, &occ, &moved);
+
     // Easy case: to is not defended (~41% of the time)
     if (!bb_test(pos->attacked, to))
         return gain[0];
 
     bitboard_t attackers = pos_attackers_to(pos, to, occ);
-    bitboard_t ourAttackers;
-
     int idx = 0;
 
     // Loop side by side and play (any) LVA recapture (~1.6 iterations on average)
-    while (us = opposite(us), ourAttackers = attackers & pos->byColor[us]) {
-        // Find least valuable attacker (LVA)
-        int lva = PAWN;
-
-        if (!(ourAttackers & pos_pieces_cp(pos, us, PAWN)))
-            for (lva = KNIGHT; lva <= KING; lva++)
-                if (ourAttackers & pos_pieces_cp(pos, us, lva))
-                    break;
-
-        // Remove the LVA
-        bb_clear(&occ, bb_lsb(ourAttackers & pos_pieces_cp(pos, us, lva)));
-
-        // Remove attackers we've already done. Purposely omit look through attacks (no elo gain).
-        attackers &= occ;
+    while (us = opposite(us), attackers & pos->byColor[us]) {
+        const int lva = see_pop_lva(pos, us, to, &occ, &attackers);
 
         // Add the new entry to the gain[] array
         idx++;
@@ -616,6 +674,48 @@ int pos_see(const Position *pos, move_t m) {
     return gain[0];
 }
 
+bool pos_see_ge(const Position *pos, move_t m, int threshold) {
+    const int to = move_to(m), us = pos->turn;
+    int moved;
+    bitboard_t occ = pos_pieces(pos);
+
+    // Best case: we win the captured piece, and keep the moving piece
+    int balance = see_first_gain(pos, m, &occ, &moved) - threshold;
+
+    if (balance < 0)
+        return false;
+
+    // Worst case: we lose the moving piece
+    balance -= PieceValue[moved];
+
+    if (balance >= 0 || !bb_test(pos->attacked, to))
+        return true;
+
+    bitboard_t attackers = pos_attackers_to(pos, to, occ);
+    int stm = us;
+
+    // Recapture with the LVA, until the side to move doesn't need to (balance >= 0), or can't
+    while (stm = opposite(stm), attackers & pos->byColor[stm]) {
+        const int lva = see_pop_lva(pos, stm, to, &occ, &attackers);
+
+        // Negamax the balance, with the LVA at stake. balance is an integer, so balance >= 0 from
+        // the opponent's pov is equivalent to -balance - 1 < 0 from ours.
+        balance = -balance - 1 - PieceValue[lva];
+
+        // stm's recapture is good enough: the opponent loses. Unless it's a king recapture into a
+        // defended square, which is illegal: then stm loses.
+        if (balance >= 0) {
+            if (!(lva == KING && (attackers & pos->byColor[opposite(stm)])))
+                stm = opposite(stm);
+
+            break;
+        }
+    }
+
+    // stm is the side that loses the exchange
+    return stm != us;
+}
+
 // Prints the position in ASCII 'art' (for debugging)
 void pos_print(const Position *pos) {
     for (int rank = RANK_8; rank >= RANK_1; rank--) {
@@ -27,6 +27,7 @@ typedef struct {
     bitboard_t castleRooks;       // rooks with castling rights (eg. A1, A8, H1, H8 in start pos)
     bitboard_t attacked;          // squares attacked by enemy
     bitboard_t checkers;          // if in check, enemy piece(s) giving check(s), otherwise empty
+    bitboard_t pins;              // pieces of the side to move, pinned to their king
     uint64_t key;         // hash key encoding all information of the position (except rule50)
     uint64_t kingPawnKey; // hash key encoding only king and pawns
     int pieceMaterial[NB_COLOR]; // endgame piece material value by color (excluding pawns)
@@ -37,6 +38,14 @@ typedef struct {
     int rule50; // ply counter for 50-move rule, ranging from 0 to 100 = draw (unless mated)
 } Position;
 
+// Compact binary encoding of a Position (27 bytes), used for training data
+typedef struct __attribute__((packed)) {
+    bitboard_t occ;     // occupied squares
+    uint8_t pieces[16]; // 4 bits per occupied square, in LSB order: color << 3 | piece, where piece
+                        // NB_PIECE is a rook with castling rights
+    uint8_t turn, epSquare, rule50;
+} PackedPos;
+
 extern const char *PieceLabel[NB_COLOR];
 
 void square_to_string(int square, char *str);
@@ -45,6 +54,9 @@ int string_to_square(const char *str);
 void pos_set(Position *pos, const char *fen);
 void pos_get(const Position *pos, char *fen);
 
+void pos_pack(const Position *pos, PackedPos *pp);
+void pos_unpack(Position *pos, const PackedPos *pp);
+
 void pos_move(Position *pos, const Position *before, move_t m);
 void pos_switch(Position *pos, const Position *before);
 
@@ -57,12 +69,12 @@ bool pos_insufficient_material(const Position *pos);
 int pos_king_square(const Position *pos, int color);
 int pos_color_on(const Position *pos, int square);
 bitboard_t pos_attackers_to(const Position *pos, int square, bitboard_t occ);
-bitboard_t calc_pins(const Position *pos);
 
 bool pos_move_is_capture(const Position *pos, move_t m);
 bool pos_move_is_castling(const Position *pos, move_t m);
 void pos_move_to_string(const Position *pos, move_t m, char *str);
 move_t pos_string_to_move(const Position *pos, const char *str);
 int pos_see(const Position *pos, move_t m);
+bool pos_see_ge(const Position *pos, move_t m, int threshold); // pos_see() >= threshold, faster
 
 void pos_print(const Position *pos);
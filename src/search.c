@@ -17,10 +17,13 @@
 #include "htable.h"
 #include "position.h"
 #include "sort.h"
+#include "stats.h"
+#include "trace.h"
 #include "uci.h"
 #include "workers.h"
 #include <math.h>
 #include <stdlib.h>
+#include <string.h>
 
 Position rootPos;
 ZobristStack rootStack;
@@ -42,6 +45,39 @@ void search_init(void) {
 
 const int Tempo = 17;
 
+// Solo searches are not monitored by the timer loop of search_go(), so they check their own limits.
+// Reading the clock is much slower than a node, so do it only every 1024 nodes.
+static bool solo_stop(Worker *worker) {
+    if (worker->maxNodes && worker->nodes >= worker->maxNodes)
+        return true;
+
+    if (worker->deadline && worker->nodes >= worker->clockNodes) {
+        worker->clockNodes = worker->nodes + 1024;
+        return system_msec() >= worker->deadline;
+    }
+
+    return false;
+}
+
+// Root moves of the previous PV lines of the current iteration (MultiPV), and moves that are not
+// root moves (searchmoves), are excluded
+static bool root_move_excluded(const Worker *worker, move_t m) {
+    for (int i = 0; i < worker->rootMovesCount; i++)
+        if (worker->rootMoves[i].move == m)
+            return i < worker->pvIdx;
+
+    return true;
+}
+
+static RootMove *root_move_find(Worker *worker, move_t m) {
+    for (int i = 0; i < worker->rootMovesCount; i++)
+        if (worker->rootMoves[i].move == m)
+            return &worker->rootMoves[i];
+
+    assert(false);
+    return NULL;
+}
+
 static int qsearch(Worker *worker, const Position *pos, int ply, int depth, int alpha, int beta,
                    bool pvNode, move_t pv[]) {
     assert(depth <= 0);
@@ -66,26 +102,31 @@ static int qsearch(Worker *worker, const Position *pos, int ply, int depth, int
         return draw_score(ply);
 
     // HT probe
-    HashEntry he = hash_read(pos->key, ply);
-    int refinedEval;
-
-    if (he.data) {
-        if (!pvNode &&
-            ((he.score <= alpha && he.bound >= EXACT) || (he.score >= beta && he.bound <= EXACT))) {
-            assert(he.depth >= depth);
-            return he.score;
-        }
+    HashEntry he = hash_read(&worker->hash, pos->key, ply);
+    bool lazy = false; // worker->eval[ply] is a lazy estimate (see evaluate_lazy())
+
+    if (he.data && !pvNode &&
+        ((he.score <= alpha && he.bound >= EXACT) || (he.score >= beta && he.bound <= EXACT))) {
+        assert(he.depth >= depth);
+        return he.score;
+    }
+
+    // Static eval from the HT, unless it only had a lazy estimate (NO_EVAL). Otherwise, the stand
+    // pat only needs to be compared to [alpha, beta], so a lazy estimate will do.
+    if (he.data && he.eval != NO_EVAL)
+        worker->eval[ply] = he.eval;
+    else
+        worker->eval[ply] =
+            pos->checkers ? -MATE
+            : zobrist_move_key(&worker->stack, 0) == ZobristTurn
+                ? -worker->eval[ply - 1] + 2 * Tempo
+                : evaluate_lazy(worker, pos, alpha - Tempo, beta - Tempo, &lazy) + Tempo;
 
-        refinedEval = worker->eval[ply] = he.eval;
+    int refinedEval = worker->eval[ply];
 
-        if ((he.score > refinedEval && he.bound <= EXACT) ||
-            (he.score < refinedEval && he.bound >= EXACT))
-            refinedEval = he.score;
-    } else
-        refinedEval = worker->eval[ply] = pos->checkers ? -MATE
-                                          : zobrist_move_key(&worker->stack, 0) == ZobristTurn
-                                              ? -worker->eval[ply - 1] + 2 * Tempo
-                                              : evaluate(worker, pos) + Tempo;
+    if (he.data && ((he.score > refinedEval && he.bound <= EXACT) ||
+                    (he.score < refinedEval && he.bound >= EXACT)))
+        refinedEval = he.score;
 
     if (ply >= MAX_PLY)
         return refinedEval;
@@ -106,21 +147,16 @@ static int qsearch(Worker *worker, const Position *pos, int ply, int depth, int
     Sort sort;
     sort_init(worker, &sort, pos, depth, he.move);
 
-    const bitboard_t pins = calc_pins(pos);
     int moveCount = 0;
 
     // Move loop
     while (sort.idx != sort.cnt && alpha < beta) {
         int see;
         const move_t currentMove = sort_next(&sort, pos, &see);
-
-        if (!gen_is_legal(pos, pins, currentMove))
-            continue;
-
         moveCount++;
 
-        // Prune losing captures in the qsearch
-        if (see < 0)
+        // Prune losing captures (and losing check evasions) in the qsearch
+        if (pos_move_is_capture(pos, currentMove) ? see < 0 : !pos_see_ge(pos, currentMove, 0))
             continue;
 
         // SEE proxy tells us we're unlikely to beat alpha
@@ -129,7 +165,7 @@ static int qsearch(Worker *worker, const Position *pos, int ply, int depth, int
 
         // Play move
         pos_move(&nextPos, pos, currentMove);
-        hash_prefetch(nextPos.key);
+        hash_prefetch(&worker->hash, nextPos.key);
         zobrist_push(&worker->stack, nextPos.key);
 
         const int nextDepth = depth - 1;
@@ -176,13 +212,13 @@ static int qsearch(Worker *worker, const Position *pos, int ply, int depth, int
         return max(alpha, mated_in(ply + 1));
     }
 
-    // HT write
+    // HT write. A lazy estimate is not stored as he.eval, which search() uses as the static eval.
     he.bound = bestScore <= oldAlpha ? UBOUND : bestScore >= beta ? LBOUND : EXACT;
     he.score = (int16_t)bestScore;
-    he.eval = (int16_t)(pos->checkers ? -MATE : worker->eval[ply]);
+    he.eval = (int16_t)(pos->checkers ? -MATE : lazy ? NO_EVAL : worker->eval[ply]);
     he.depth = 0;
     he.move = bestMove;
-    hash_write(pos->key, &he, ply);
+    hash_write(&worker->hash, pos->key, &he, ply);
 
     return bestScore;
 }
@@ -209,7 +245,7 @@ static int search(Worker *worker, const Position *pos, int ply, int depth, int a
     int score;
     Position nextPos;
 
-    if (atomic_load_explicit(&Stop, memory_order_relaxed))
+    if (atomic_load_explicit(&Stop, memory_order_relaxed) || (worker->solo && solo_stop(worker)))
         longjmp(worker->jbuf, 1);
 
     // Allocate PV for the child node, and terminate current PV
@@ -221,50 +257,64 @@ static int search(Worker *worker, const Position *pos, int ply, int depth, int a
 
     // HT probe
     const uint64_t key = pos->key ^ singularMove;
-    HashEntry he = hash_read(key, ply);
-    int refinedEval;
+    HashEntry he = hash_read(&worker->hash, key, ply);
+
+    if (he.data && he.depth >= depth && !pvNode &&
+        ((he.score <= alpha && he.bound >= EXACT) || (he.score >= beta && he.bound <= EXACT)))
+        return he.score;
 
-    if (he.data) {
-        if (he.depth >= depth && !pvNode &&
-            ((he.score <= alpha && he.bound >= EXACT) || (he.score >= beta && he.bound <= EXACT)))
-            return he.score;
+    // Static eval from the HT, unless qsearch() only had a lazy estimate (NO_EVAL)
+    if (he.data && he.eval != NO_EVAL)
+        worker->eval[ply] = he.eval;
+    else
+        worker->eval[ply] = pos->checkers ? -MATE
+                            : zobrist_move_key(&worker->stack, 0) == ZobristTurn
+                                ? -worker->eval[ply - 1] + 2 * Tempo
+                                : evaluate(worker, pos) + Tempo;
 
-        refinedEval = worker->eval[ply] = he.eval;
+    int refinedEval = worker->eval[ply];
 
-        if ((he.score > refinedEval && he.bound <= EXACT) ||
-            (he.score < refinedEval && he.bound >= EXACT))
-            refinedEval = he.score;
-    } else
-        refinedEval = worker->eval[ply] = pos->checkers ? -MATE
-                                          : zobrist_move_key(&worker->stack, 0) == ZobristTurn
-                                              ? -worker->eval[ply - 1] + 2 * Tempo
-                                              : evaluate(worker, pos) + Tempo;
+    if (he.data && ((he.score > refinedEval && he.bound <= EXACT) ||
+                    (he.score < refinedEval && he.bound >= EXACT)))
+        refinedEval = he.score;
 
     // At Root, ensure that the last best move is searched first. This is not guaranteed,
     // as the HT entry could have got overriden by other search threads.
-    if (ply == 0 && info_last_depth(&ui) > 0)
-        he.move = info_best(&ui);
+    // For the next PV lines (MultiPV), use the move of the same line in the last iteration.
+    if (ply == 0 && !worker->solo && info_last_depth(&ui) > 0)
+        he.move = worker->pvIdx ? worker->rootMoves[worker->pvIdx].move : info_best(&ui);
 
     if (ply >= MAX_PLY)
         return refinedEval;
 
     // Eval pruning
-    if (depth <= 6 && !pos->checkers && !pvNode && pos->pieceMaterial[us] &&
-        refinedEval >= beta + EvalMargin[depth])
-        return refinedEval;
+    if (depth <= 6 && !pos->checkers && !pvNode && pos->pieceMaterial[us]) {
+        STAT_INC(worker, STAT_EVAL_PRUNE);
+
+        if (refinedEval >= beta + EvalMargin[depth]) {
+            STAT_INC(worker, STAT_EVAL_PRUNE_CUT);
+            return refinedEval;
+        }
+    }
 
     // Razoring
     if (depth <= 5 && !pos->checkers && !singularMove && !pvNode) {
         const int lbound = alpha - RazorMargin[depth];
 
         if (refinedEval <= lbound) {
-            if (depth <= 2)
+            STAT_INC(worker, STAT_RAZOR);
+
+            if (depth <= 2) {
+                STAT_INC(worker, STAT_RAZOR_CUT);
                 return qsearch(worker, pos, ply, 0, alpha, alpha + 1, false, childPv);
+            }
 
             score = qsearch(worker, pos, ply, 0, lbound, lbound + 1, false, childPv);
 
-            if (score <= lbound)
+            if (score <= lbound) {
+                STAT_INC(worker, STAT_RAZOR_CUT);
                 return score;
+            }
         }
     }
 
@@ -280,6 +330,7 @@ static int search(Worker *worker, const Position *pos, int ply, int depth, int a
 
         pos_switch(&nextPos, pos);
         zobrist_push(&worker->stack, nextPos.key);
+        STAT_INC(worker, STAT_NULL);
 
         score =
             nextDepth <= 0
@@ -288,12 +339,13 @@ static int search(Worker *worker, const Position *pos, int ply, int depth, int a
 
         zobrist_pop(&worker->stack);
 
-        if (score >= beta)
+        if (score >= beta) {
+            STAT_INC(worker, STAT_NULL_CUT);
             return score >= mate_in(MAX_PLY) ? beta : score;
+        }
     }
 
     Sort sort;
-    const bitboard_t pins = calc_pins(pos);
 
     // Prob cut
     if (depth >= 5 && !pvNode && !pos->checkers && beta + ProbcutMargin <= MATE) {
@@ -307,8 +359,8 @@ static int search(Worker *worker, const Position *pos, int ply, int depth, int a
             int see;
             const move_t capture = sort_next(&sort, pos, &see);
 
-            // Skip if move is illegal or singular (excluded from search at this node)
-            if (!gen_is_legal(pos, pins, capture) || capture == singularMove)
+            // Skip if move is singular (excluded from search at this node)
+            if (capture == singularMove)
                 continue;
 
             // If SEE <= 0, we're done, since captures are sorted by descending SEE, and we only
@@ -321,29 +373,36 @@ static int search(Worker *worker, const Position *pos, int ply, int depth, int a
             zobrist_push(&worker->stack, nextPos.key);
 
             // Reduced search on [ubound-1, ubound] <=> [-ubound,-ubound+1] for opponent
+            STAT_INC(worker, STAT_PROBCUT);
             score = -search(worker, &nextPos, ply + 1, depth - 4, -ubound, -ubound + 1, childPv, 0);
 
             // Undo the move
             zobrist_pop(&worker->stack);
 
-            if (score >= ubound)
+            if (score >= ubound) {
+                STAT_INC(worker, STAT_PROBCUT_CUT);
                 return score;
+            }
         }
     }
 
-    // Generate and score moves
+    // Generate and score moves. At the root, keep the ranking of the last iteration.
     sort_init(worker, &sort, pos, depth, he.move);
 
+    if (ply == 0 && depth > 1)
+        sort_root(&sort, worker->rootMoves, worker->rootMovesCount, he.move);
+
     int moveCount = 0, lmrCount = 0;
     move_t quietSearched[MAX_MOVES];
     int quietSearchedCnt = 0;
+    STAT_ADD(worker, nodes, depth);
 
     // Move loop
     while (sort.idx != sort.cnt && alpha < beta) {
         int see;
         const move_t currentMove = sort_next(&sort, pos, &see);
 
-        if (!gen_is_legal(pos, pins, currentMove) || currentMove == singularMove)
+        if (currentMove == singularMove || (ply == 0 && root_move_excluded(worker, currentMove)))
             continue;
 
         moveCount++;
@@ -364,20 +423,29 @@ static int search(Worker *worker, const Position *pos, int ply, int depth, int a
 
         // Prune bad or late moves near the leaves
         if (depth <= 5 && !pvNode && !nextPos.checkers && moveCount >= 2) {
+            STAT_INC(worker, STAT_LATE);
+
             // SEE pruning
-            if (see < SEEMargin[capture][depth])
+            if (capture ? see < SEEMargin[capture][depth]
+                        : !pos_see_ge(pos, currentMove, SEEMargin[capture][depth])) {
+                STAT_INC(worker, STAT_SEE_PRUNE);
                 continue;
+            }
 
             // Late Move Pruning
-            if (!capture && depth <= 4 && moveCount >= 3 * depth + 2 * improving)
+            if (!capture && depth <= 4 && moveCount >= 3 * depth + 2 * improving) {
+                STAT_INC(worker, STAT_LMP);
                 break;
+            }
 
             // Prune quiet moves with negative history
-            if (!capture && depth <= 3 && sort.scores[sort.idx - 1] < 0)
+            if (!capture && depth <= 3 && sort.scores[sort.idx - 1] < 0) {
+                STAT_INC(worker, STAT_HISTORY_PRUNE);
                 break;
+            }
         }
 
-        hash_prefetch(nextPos.key);
+        hash_prefetch(&worker->hash, nextPos.key);
 
         // Search extension
         int ext = 0;
@@ -388,17 +456,27 @@ static int search(Worker *worker, const Position *pos, int ply, int depth, int a
             const int lbound = he.score - 2 * depth;
 
             if (abs(lbound) < MATE) {
+                STAT_INC(worker, STAT_SINGULAR);
                 score =
                     search(worker, pos, ply, depth - 4, lbound, lbound + 1, childPv, currentMove);
                 ext = score <= lbound;
+
+                if (ext)
+                    STAT_INC(worker, STAT_SINGULAR_EXT);
             }
-        } else
+        } else {
             // Check extension
-            ext = see >= 0 && nextPos.checkers;
+            ext = nextPos.checkers && (capture ? see >= 0 : pos_see_ge(pos, currentMove, 0));
+
+            if (ext)
+                STAT_INC(worker, STAT_CHECK_EXT);
+        }
 
         zobrist_push(&worker->stack, nextPos.key);
 
         nextDepth = depth - 1 + ext;
+        const uint64_t nodes = worker->nodes;
+        STAT_ADD(worker, moves, depth);
 
         // Recursion
         if (nextDepth <= 0)
@@ -416,7 +494,8 @@ static int search(Worker *worker, const Position *pos, int ply, int depth, int a
                     assert(1 <= lmrCount && lmrCount <= MAX_MOVES);
                     reduction = Reduction[nextDepth][lmrCount] + !improving;
 
-                    if (sort.scores[sort.idx - 1] >= 1024)
+                    // Good history (root moves are scored by rank instead)
+                    if (ply > 0 && sort.scores[sort.idx - 1] >= 1024)
                         reduction = max(0, reduction - 1);
                 }
 
@@ -427,21 +506,34 @@ static int search(Worker *worker, const Position *pos, int ply, int depth, int a
                             : -search(worker, &nextPos, ply + 1, nextDepth - reduction,
                                       -(alpha + 1), -alpha, childPv, 0);
 
+                if (reduction)
+                    STAT_INC(worker, STAT_LMR);
+
+                if (pvNode)
+                    STAT_INC(worker, STAT_PVS);
+
                 // Fail high: re-search zero window at full depth
-                if (reduction && score > alpha)
+                if (reduction && score > alpha) {
+                    STAT_INC(worker, STAT_LMR_RESEARCH);
                     score = -search(worker, &nextPos, ply + 1, nextDepth, -(alpha + 1), -alpha,
                                     childPv, 0);
+                }
 
                 // Fail high at full depth for pvNode: re-search full window
-                if (pvNode && alpha < score && score < beta)
+                if (pvNode && alpha < score && score < beta) {
+                    STAT_INC(worker, STAT_PVS_RESEARCH);
                     score =
                         -search(worker, &nextPos, ply + 1, nextDepth, -beta, -alpha, childPv, 0);
+                }
             }
         }
 
         // Undo move
         zobrist_pop(&worker->stack);
 
+        if (ply == 0)
+            root_move_find(worker, currentMove)->nodes += worker->nodes - nodes;
+
         // New best score
         if (score > bestScore) {
             bestScore = score;
@@ -451,6 +543,9 @@ static int search(Worker *worker, const Position *pos, int ply, int depth, int a
                 alpha = score;
                 bestMove = currentMove;
 
+                if (alpha >= beta)
+                    STAT_CUTOFF(worker, pvNode, depth, moveCount);
+
                 if (pvNode) {
                     pv[0] = currentMove;
 
@@ -458,10 +553,24 @@ static int search(Worker *worker, const Position *pos, int ply, int depth, int a
                         if (!(pv[i + 1] = childPv[i]))
                             break;
 
+                    // Solve time and nodes, for EPD test suites (see search_solo())
+                    if (ply == 0 && worker->solo && currentMove != worker->bestMove) {
+                        worker->bestMove = currentMove;
+                        worker->bestTime = system_msec() - worker->start;
+                        worker->bestNodes = worker->nodes;
+                    }
+
                     // Best move has changed since last completed iteration. Update the best move
                     // and PV immediately, because we may not have time to finish this iteration.
-                    if (ply == 0 && moveCount > 1 && depth > 1)
-                        info_update(&ui, depth, score, workers_nodes(), pv, true);
+                    if (ply == 0 && moveCount > 1 && depth > 1 && !worker->solo && !worker->pvIdx) {
+                        TRACE(worker - Workers, TRACE_BEST_MOVE, depth, score, currentMove);
+                        RootMove line = {.move = currentMove, .score = score};
+
+                        for (int i = 0; (line.pv[i] = pv[i]); i++)
+                            ;
+
+                        info_update(&ui, depth, workers_nodes(), &line, 1, true, 0);
+                    }
                 }
             }
         }
@@ -492,34 +601,48 @@ static int search(Worker *worker, const Position *pos, int ply, int depth, int a
         }
     }
 
-    // HT write
-    he.bound = bestScore <= oldAlpha ? UBOUND : bestScore >= beta ? LBOUND : EXACT;
-    he.score = (int16_t)bestScore;
-    he.eval = (int16_t)(pos->checkers ? -MATE : worker->eval[ply]);
-    he.depth = (int8_t)depth;
-    he.move = bestMove;
-    hash_write(key, &he, ply);
+    // HT write, unless root moves were excluded (MultiPV, searchmoves): the result is not the root
+    // node's
+    if (ply > 0 || (!worker->pvIdx && !worker->rootRestricted)) {
+        he.bound = bestScore <= oldAlpha ? UBOUND : bestScore >= beta ? LBOUND : EXACT;
+        he.score = (int16_t)bestScore;
+        he.eval = (int16_t)(pos->checkers ? -MATE : worker->eval[ply]);
+        he.depth = (int8_t)depth;
+        he.move = bestMove;
+        hash_write(&worker->hash, key, &he, ply);
+    }
 
     return bestScore;
 }
 
-static int aspirate(Worker *worker, int depth, move_t pv[], int score) {
+static int aspirate(Worker *worker, const Position *pos, int depth, move_t pv[], int score) {
     assert(depth > 0);
 
     if (depth == 1)
-        return search(worker, &rootPos, 0, depth, -MATE, MATE, pv, 0);
+        return search(worker, pos, 0, depth, -MATE, MATE, pv, 0);
 
+    AspirationStats *stats = &worker->aspiration[min(depth, MAX_DEPTH)];
     int delta = 15;
     int alpha = max(score - delta, -MATE);
     int beta = min(score + delta, MATE);
 
     for (;; delta += delta / 2) {
-        score = search(worker, &rootPos, 0, depth, alpha, beta, pv, 0);
+        const uint64_t nodes = worker->nodes;
+        score = search(worker, pos, 0, depth, alpha, beta, pv, 0);
+
+        stats->searches++;
+        stats->nodes += worker->nodes - nodes;
 
         if (score <= alpha) {
+            TRACE(worker - Workers, TRACE_FAIL_LOW, depth, score, 0);
+            stats->failLows++;
+            stats->failedNodes += worker->nodes - nodes;
             beta = (alpha + beta) / 2;
             alpha = max(alpha - delta, -MATE);
         } else if (score >= beta) {
+            TRACE(worker - Workers, TRACE_FAIL_HIGH, depth, score, 0);
+            stats->failHighs++;
+            stats->failedNodes += worker->nodes - nodes;
             alpha = (alpha + beta) / 2;
             beta = min(beta + delta, MATE);
         } else
@@ -527,22 +650,137 @@ static int aspirate(Worker *worker, int depth, move_t pv[], int score) {
     }
 }
 
+// Root moves are the legal moves, restricted to limits->searchMoves if any. When the root is the
+// same position as the last search (eg. a GUI restarting the search), root moves inherit half the
+// nodes of the same moves in the last search, as a prior to rank them (see root_moves_sort()).
+static void root_moves_init(Worker *worker, const Position *pos, const Limits *limits) {
+    move_t mList[MAX_MOVES];
+    const move_t *end = gen_all_moves(pos, mList);
+
+    move_t lastMoves[MAX_MOVES];
+    uint64_t lastNodes[MAX_MOVES];
+    const int lastCount = pos->key == worker->lastRootKey ? worker->rootMovesCount : 0;
+
+    for (int i = 0; i < lastCount; i++) {
+        lastMoves[i] = worker->rootMoves[i].move;
+        lastNodes[i] = worker->rootMoves[i].nodes + worker->rootMoves[i].priorNodes;
+    }
+
+    worker->lastRootKey = pos->key;
+
+    worker->rootMovesCount = 0;
+    worker->rootRestricted = limits->searchMovesCount > 0;
+    worker->pvIdx = 0;
+
+    for (const move_t *m = mList; m != end; m++) {
+        bool searched = !worker->rootRestricted;
+
+        for (int i = 0; i < limits->searchMovesCount && !searched; i++)
+            searched = limits->searchMoves[i] == *m;
+
+        if (!searched)
+            continue;
+
+        RootMove *rm = &worker->rootMoves[worker->rootMovesCount++];
+        *rm = (RootMove){.move = *m, .score = -MATE, .previousScore = -MATE};
+
+        for (int i = 0; i < lastCount; i++)
+            if (lastMoves[i] == *m)
+                rm->priorNodes = lastNodes[i] / 2;
+    }
+}
+
+// Record the PV line found at pvIdx, and move its root move to rank pvIdx, keeping the order of
+// the others (last iteration's ranking).
+static void root_moves_update(Worker *worker, int score, const move_t pv[]) {
+    RootMove *rootMoves = worker->rootMoves;
+    int i = worker->pvIdx;
+
+    while (i < worker->rootMovesCount && rootMoves[i].move != pv[0])
+        i++;
+
+    if (i == worker->rootMovesCount) {
+        // No legal move: mated or stalemated
+        assert(!worker->rootMovesCount);
+        rootMoves[0] = (RootMove){.score = score, .previousScore = score};
+        return;
+    }
+
+    const RootMove rm = rootMoves[i];
+    memmove(&rootMoves[worker->pvIdx + 1], &rootMoves[worker->pvIdx],
+            (size_t)(i - worker->pvIdx) * sizeof(RootMove));
+    rootMoves[worker->pvIdx] = rm;
+    rootMoves[worker->pvIdx].score = score;
+
+    for (int j = 0; (rootMoves[worker->pvIdx].pv[j] = pv[j]); j++)
+        ;
+}
+
+// Rank root moves for the next iteration: PV lines by descending score (lines searched later can
+// score higher, because of search instability), then the others by descending nodes searched
+// (including prior nodes).
+static void root_moves_sort(Worker *worker, int multiPV) {
+    RootMove *rootMoves = worker->rootMoves;
+
+    for (int i = 1; i < worker->rootMovesCount; i++) {
+        const RootMove rm = rootMoves[i];
+        int j = i;
+
+        if (i < multiPV)
+            for (; j > 0 && rootMoves[j - 1].score < rm.score; j--)
+                rootMoves[j] = rootMoves[j - 1];
+        else
+            for (; j > multiPV && rootMoves[j - 1].nodes + rootMoves[j - 1].priorNodes <
+                                      rm.nodes + rm.priorNodes;
+                 j--)
+                rootMoves[j] = rootMoves[j - 1];
+
+        rootMoves[j] = rm;
+    }
+}
+
+// Search the PV lines of an iteration one by one, excluding the root moves of the previous ones.
+// The aspiration window of each line is centered on its score from the last iteration.
+static void search_lines(Worker *worker, const Position *pos, int depth, int multiPV) {
+    move_t pv[MAX_PLY + 1];
+
+    for (int i = 0; i < worker->rootMovesCount; i++) {
+        worker->rootMoves[i].previousScore = worker->rootMoves[i].score;
+        worker->rootMoves[i].score = -MATE;
+    }
+
+    for (worker->pvIdx = 0; worker->pvIdx < multiPV; worker->pvIdx++) {
+        const int score =
+            aspirate(worker, pos, depth, pv, worker->rootMoves[worker->pvIdx].previousScore);
+        root_moves_update(worker, score, pv);
+    }
+
+    worker->pvIdx = 0;
+    root_moves_sort(worker, multiPV);
+}
+
 static void *iterate(void *_worker) {
     Worker *worker = _worker;
-    move_t pv[MAX_PLY + 1];
-    int volatile score = 0;
+
+    root_moves_init(worker, &rootPos, &lim);
+    const int multiPV = worker->rootMovesCount ? min(uciMultiPV, worker->rootMovesCount) : 1;
 
     for (volatile int depth = 1; depth <= lim.depth; depth++) {
+        TRACE(worker - Workers, TRACE_ITERATION_START, depth, 0, 0);
+
         if (!setjmp(worker->jbuf))
-            score = aspirate(worker, depth, pv, score);
+            search_lines(worker, &rootPos, depth, multiPV);
         else {
+            TRACE(worker - Workers, TRACE_ITERATION_ABORT, depth, 0, 0);
             worker->stack.idx = rootStack.idx; // Restore stack position
             break;
         }
 
+        TRACE(worker - Workers, TRACE_ITERATION_END, depth, worker->rootMoves[0].score, 0);
         const uint64_t nodes = workers_nodes();
 
-        info_update(&ui, depth, score, nodes, pv, false);
+        info_update(&ui, depth, nodes, worker->rootMoves, multiPV, false,
+                    (double)worker->rootMoves[0].nodes / (double)max(worker->nodes, 1));
 
         if (lim.nodes && nodes >= lim.nodes)
             break;
@@ -550,8 +788,8 @@ static void *iterate(void *_worker) {
 
     // Max depth completed by current thread. All threads should stop. Unless we are in infinite
     // or pondering, in which case workers wait here, and the timer loop continues until stopped.
-    if (!lim.infinite && !uciFakeTime)
-        Stop = true;
+    if (!atomic_load_explicit(&lim.infinite, memory_order_acquire) && !uciFakeTime)
+        atomic_store_explicit(&Stop, true, memory_order_release);
 
     return NULL;
 }
@@ -565,6 +803,28 @@ bool is_mate_score(int score) {
     return abs(score) >= MATE - MAX_PLY;
 }
 
+// Time to spend on this move, between minTime and maxTime
+static int64_t time_target(const SearchProgress *p, int64_t minTime, int64_t maxTime) {
+    // Blend minTime and maxTime with a logistic curve of the best move variability
+    const double x = 1 / (1 + exp(-p->variability));
+    double t = x * (double)maxTime + (1 - x) * (double)minTime;
+
+    if (p->depth >= 8) {
+        // Easy move: when the best move has consumed most of the nodes, the alternatives were
+        // refuted quickly. Scale down from 100% (effort <= 80%) to 50% (effort 100%).
+        t *= min(1.0, 0.5 + 2.5 * (1 - p->effort));
+
+        // Best move confirmed by the last iterations: up to 20% less
+        t *= 1 - 0.04 * min(p->stability, 5);
+
+        // Score dropping: up to 50% more, for a drop of 30cp or more
+        const int drop = max(p->scoreDrop, 0);
+        t *= 1 + 0.5 * min(drop, 60) / 60.0;
+    }
+
+    return min((int64_t)t, maxTime);
+}
+
 uint64_t search_go(void) {
     int64_t start = system_msec();
 
@@ -575,6 +835,14 @@ uint64_t search_go(void) {
     pthread_t threads[WorkersCount];
     workers_new_search();
 
+    const int timer = (int)WorkersCount; // trace thread index, after the workers
+    int stopReason = TRACE_STOP_OTHER;
+
+    if (TraceEnabled)
+        trace_prepare(WorkersCount + 1);
+
+    TRACE(timer, TRACE_SEARCH_START, 0, 0, 0);
+
     int64_t minTime = 0, maxTime = 0;
 
     if (!lim.movetime && (lim.time || lim.inc)) {
@@ -596,27 +864,74 @@ uint64_t search_go(void) {
         // Start searching thread
         pthread_create(&threads[i], NULL, (void *(*)(void *))iterate, &Workers[i]);
 
+    int checkedDepth = 0;          // last iteration boundary seen by the timer loop
+    int64_t iterationEnd = 0;      // predicted end of the current iteration, if allowed to finish
+    bool ponderhitChecked = false; // the iteration running at ponderhit has been predicted
+
     do {
         sleep_msec(6);
+        const SearchProgress progress = info_progress(&ui);
 
         // Check for search termination conditions, but only after depth 1 has been
         // completed, to make sure we do not return an illegal move.
-        if (!lim.infinite && info_last_depth(&ui) > 0) {
-            if ((lim.movetime && system_msec() - start >= lim.movetime - uciTimeBuffer) ||
-                (!uciFakeTime && lim.nodes && workers_nodes() >= lim.nodes))
+        if (!atomic_load_explicit(&lim.infinite, memory_order_acquire) && progress.depth > 0) {
+            // After ponderhit, the time spent pondering counts as search time (elapsed), but our
+            // clock only runs since ponderhit: maxTime and movetime apply to the clock. ponderhit
+            // stays 0 if the ponder search is stopped instead.
+            const int64_t elapsed = system_msec() - start;
+            const int64_t ponderhit =
+                lim.ponder ? atomic_load_explicit(&lim.ponderhit, memory_order_relaxed) : 0;
+            const int64_t pondered = ponderhit ? ponderhit - start : 0;
+
+            if (lim.movetime && elapsed - pondered >= lim.movetime - uciTimeBuffer) {
+                stopReason = TRACE_STOP_MOVETIME;
                 atomic_store_explicit(&Stop, true, memory_order_release);
-            else if (lim.time || lim.inc) {
-                const double x = 1 / (1 + exp(-info_variability(&ui)));
-                const int64_t t = x * (double)maxTime + (1 - x) * (double)minTime;
-
-                if (system_msec() - start >= t)
+            } else if (!uciFakeTime && lim.nodes && workers_nodes() >= lim.nodes) {
+                stopReason = TRACE_STOP_NODES;
+                atomic_store_explicit(&Stop, true, memory_order_release);
+            } else if (lim.time || lim.inc) {
+                const int64_t target = time_target(&progress, minTime, maxTime);
+
+                if (ponderhit && !ponderhitChecked) {
+                    // First check after ponderhit: the target may already be spent pondering, and
+                    // iterationEnd is stale. Predict the end of the iteration running now, as at
+                    // an iteration boundary, and let it finish if it fits in maxTime on our clock.
+                    ponderhitChecked = true;
+                    checkedDepth = progress.depth;
+                    iterationEnd = progress.iterationEnd + 2 * progress.iterationTime;
+
+                    if (iterationEnd > maxTime + pondered) {
+                        stopReason = TRACE_STOP_ITERATION;
+                        atomic_store_explicit(&Stop, true, memory_order_release);
+                    }
+                } else if (elapsed >= max(target, iterationEnd)) {
+                    stopReason = TRACE_STOP_TIME;
                     atomic_store_explicit(&Stop, true, memory_order_release);
+                } else if (progress.depth > checkedDepth) {
+                    // Iteration boundary: predict when the next iteration ends, assuming it takes
+                    // twice as long as the last one. Stop now, rather than abort it halfway, if it
+                    // would overshoot the target by more than the slack (increment repays it).
+                    const int64_t slack = max(target / 4, lim.inc / 2);
+                    checkedDepth = progress.depth;
+                    iterationEnd = progress.iterationEnd + 2 * progress.iterationTime;
+
+                    if (iterationEnd > min(target + slack, maxTime + pondered)) {
+                        stopReason = TRACE_STOP_ITERATION;
+                        atomic_store_explicit(&Stop, true, memory_order_release);
+                    }
+                }
             }
         }
     } while (!atomic_load_explicit(&Stop, memory_order_acquire));
 
-    for (size_t i = 0; i < WorkersCount; i++)
+    TRACE(timer, TRACE_STOP, info_last_depth(&ui), stopReason, 0);
+
+    for (size_t i = 0; i < WorkersCount; i++) {
         pthread_join(threads[i], NULL);
+        TRACE(timer, TRACE_JOIN, 0, (int)i, 0);
+    }
+
+    TRACE(timer, TRACE_SEARCH_END, 0, 0, 0);
 
     info_print_bestmove(&ui);
     info_destroy(&ui);
@@ -624,6 +939,60 @@ uint64_t search_go(void) {
     return workers_nodes();
 }
 
+int search_solo(Worker *worker, const Position *pos, const Limits *limits, move_t pv[]) {
+    assert(zobrist_back(&worker->stack) == pos->key);
+    const int stackIdx = worker->stack.idx;
+    int volatile score = 0;
+
+    // Best move change of the last completed iteration, to restore if the next one is aborted
+    volatile int64_t bestTime = 0;
+    volatile uint64_t bestNodes = 0;
+
+    pv[0] = 0;
+    root_moves_init(worker, pos, limits);
+    worker->nodes = worker->maxNodes = worker->clockNodes = 0;
+    worker->deadline = 0;
+    worker->start = system_msec();
+    worker->bestMove = 0;
+    worker->bestTime = 0;
+    worker->bestNodes = 0;
+    worker->solo = true;
+
+    for (volatile int depth = 1; depth <= limits->depth; depth++) {
+        if (!setjmp(worker->jbuf))
+            search_lines(worker, pos, depth, 1);
+        else {
+            worker->stack.idx = stackIdx; // Restore stack position
+
+            // The aborted iteration is discarded, and so are its best move changes
+            if (worker->bestMove != pv[0]) {
+                worker->bestMove = pv[0];
+                worker->bestTime = bestTime;
+                worker->bestNodes = bestNodes;
+            }
+
+            break;
+        }
+
+        score = worker->rootMoves[0].score;
+        bestTime = worker->bestTime;
+        bestNodes = worker->bestNodes;
+
+        for (int i = 0; (pv[i] = worker->rootMoves[0].pv[i]); i++)
+            ;
+
+        // Enforce limits only after depth 1 has been completed, so that we have a best move
+        worker->maxNodes = limits->nodes;
+        worker->deadline = limits->movetime ? worker->start + limits->movetime : 0;
+
+        if (solo_stop(worker))
+            break;
+    }
+
+    worker->solo = false;
+    return score;
+}
+
 void *search_posix(void *dummy) {
     (void)dummy; // silence compiler warning (unused variable)
     search_go();
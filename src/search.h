@@ -13,6 +13,7 @@
  * not, see <http://www.gnu.org/licenses/>.
  */
 #pragma once
+#include "gen.h"
 #include "position.h"
 #include "zobrist.h"
 #include <stdatomic.h>
@@ -27,9 +28,23 @@ typedef struct {
     int64_t movetime, time, inc;
     uint64_t nodes;
     int depth, movestogo;
-    atomic_bool infinite; // IO thread can change this while Timer thread is checking it
+    atomic_bool infinite;      // IO thread can change this while Timer thread is checking it
+    bool ponder;               // "go ponder": infinite until ponderhit
+    _Atomic int64_t ponderhit; // system_msec() at ponderhit (0 = not yet)
+    move_t searchMoves[MAX_MOVES]; // restrict the root search to these moves, if any
+    int searchMovesCount;
 } Limits;
 
+// Root move, with the score and PV of the PV line it produced (see MultiPV in iterate()), and the
+// nodes spent searching it
+typedef struct {
+    move_t move;
+    int score, previousScore; // current and last iteration, -MATE if not a PV line
+    uint64_t nodes;           // cumulated over the whole search
+    uint64_t priorNodes;      // inherited from the last search of this root (see root_moves_init())
+    move_t pv[MAX_PLY + 1];
+} RootMove;
+
 int mated_in(int ply);
 int mate_in(int ply);
 bool is_mate_score(int score);
@@ -42,6 +57,14 @@ extern Limits lim;
 extern int Contempt;
 extern const int Tempo;
 
+typedef struct Worker Worker;
+
 void search_init(void);
 uint64_t search_go(void);
+
+// Search pos with a single worker, on the calling thread, independently from search_go() and UCI
+// globals (rootPos, lim, ui). Used to run concurrent searches. Only nodes, movetime and depth
+// limits apply. Returns the score and fills pv[] from the last completed iteration. The time and
+// nodes when the best move was found are in worker->bestTime and worker->bestNodes.
+int search_solo(Worker *worker, const Position *pos, const Limits *limits, move_t pv[]);
 void *search_posix(void *); // POSIX wrapper for pthread_create()
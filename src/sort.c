@@ -19,7 +19,11 @@
 #include <limits.h>
 #include <stdlib.h>
 
-enum { HISTORY_MAX = MAX_DEPTH * MAX_DEPTH, SEPARATION = 3 * HISTORY_MAX + 1 };
+enum {
+    HISTORY_MAX = MAX_DEPTH * MAX_DEPTH,
+    SEPARATION = 3 * HISTORY_MAX + 1,
+    ROOT_SCORE = INT_MAX - MAX_MOVES // root moves are scored above (see sort_root())
+};
 
 static void sort_generate(Sort *sort, const Position *pos, int depth) {
     move_t *it = sort->moves;
@@ -83,6 +87,17 @@ void sort_init(Worker *worker, Sort *sort, const Position *pos, int depth, move_
     sort->idx = 0;
 }
 
+void sort_root(Sort *sort, const RootMove rootMoves[], int count, move_t ttMove) {
+    for (size_t i = 0; i < sort->cnt; i++) {
+        int rank = 0;
+
+        while (rank < count && rootMoves[rank].move != sort->moves[i])
+            rank++;
+
+        sort->scores[i] = sort->moves[i] == ttMove ? INT_MAX : INT_MAX - 1 - rank;
+    }
+}
+
 move_t sort_next(Sort *sort, const Position *pos, int *see) {
     int maxScore = INT_MIN;
     size_t maxIdx = sort->idx;
@@ -113,8 +128,8 @@ move_t sort_next(Sort *sort, const Position *pos, int *see) {
     if (pos_move_is_capture(pos, m)) {
         // Deduce SEE from the sort score
         if (score >= SEPARATION)
-            *see = score == INT_MAX
-                       ? pos_see(pos, m)     // special case: HT move is scored as INT_MAX
+            *see = score >= ROOT_SCORE
+                       ? pos_see(pos, m)     // special case: HT move and root moves
                        : score - SEPARATION; // Good captures are scored as SEE + SEPARATION
         else {
             assert(score < -SEPARATION);
@@ -123,7 +138,7 @@ move_t sort_next(Sort *sort, const Position *pos, int *see) {
 
         assert(*see == pos_see(pos, m));
     } else
-        *see = pos_see(pos, m);
+        *see = 0; // not computed for quiet moves (see sort.h)
 
     return sort->moves[sort->idx++];
 }
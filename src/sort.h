@@ -25,4 +25,10 @@ typedef struct {
 } Sort;
 
 void sort_init(Worker *worker, Sort *sort, const Position *pos, int depth, move_t ttMove);
+// Root node: order moves by rank in rootMoves[] (after ttMove), instead of move sorting statistics.
+// Moves that are not root moves (see Limits.searchMoves) come last.
+void sort_root(Sort *sort, const RootMove rootMoves[], int count, move_t ttMove);
+
+// Return the next best move. For captures, see is their SEE (deduced from the sort score). Quiet
+// moves have see = 0, and callers use pos_see_ge() when they need to know if they lose material.
 move_t sort_next(Sort *sort, const Position *pos, int *see);
@@ -0,0 +1,73 @@
+/*
+ * Demolito, a UCI chess engine. Copyright 2015-2020 lucasart.
+ *
+ * Demolito is free software: you can redistribute it and/or modify it under the terms of the GNU
+ * General Public License as published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * Demolito is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with this program. If
+ * not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+#include <inttypes.h>
+
+// Search statistics, counted per worker. They are compiled out completely, unless STATS is defined
+// (make stats): STAT_INC() and STAT_ADD() expand to nothing, and Worker has no stats field.
+
+// Pruning and extension counters come in pairs: attempts, then successes
+enum {
+    STAT_EVAL_PRUNE,     // eval pruning: eligible nodes
+    STAT_EVAL_PRUNE_CUT, // ... pruned
+    STAT_RAZOR,          // razoring: qsearch verifications
+    STAT_RAZOR_CUT,      // ... pruned
+    STAT_NULL,           // null move: null searches
+    STAT_NULL_CUT,       // ... fail high
+    STAT_PROBCUT,        // probcut: capture searches
+    STAT_PROBCUT_CUT,    // ... fail high
+    STAT_LATE,           // late moves eligible for pruning
+    STAT_SEE_PRUNE,      // ... pruned by SEE
+    STAT_LMP,            // ... nodes ended by late move pruning
+    STAT_HISTORY_PRUNE,  // ... nodes ended by negative history pruning
+    STAT_SINGULAR,       // singular extension: verification searches
+    STAT_SINGULAR_EXT,   // ... extended
+    STAT_CHECK_EXT,      // check extensions
+    STAT_LMR,            // reduced searches
+    STAT_LMR_RESEARCH,   // ... re-searched at full depth (fail high)
+    STAT_PVS,            // zero window searches in PV nodes
+    STAT_PVS_RESEARCH,   // ... re-searched with full window (fail high)
+    STAT_PAWN_PROBE,     // pawn hash: probes
+    STAT_PAWN_HIT,       // ... hits
+    STAT_LAZY_PROBE,     // lazy eval: evaluations with a window (see evaluate_lazy())
+    STAT_LAZY_EXIT,      // ... early exits
+    NB_STAT
+};
+
+enum { STAT_MAX_DEPTH = 24 }; // deeper nodes are counted at STAT_MAX_DEPTH
+enum { CUTOFF_DEPTH = 16, CUTOFF_INDEX = 16 }; // cutoff histogram bounds (last slot = and above)
+
+typedef struct {
+    uint64_t counters[NB_STAT];
+    uint64_t nodes[STAT_MAX_DEPTH + 1], moves[STAT_MAX_DEPTH + 1]; // per depth (move loops only)
+
+    // Beta cutoffs by node type (non-PV, PV), depth, and index of the cutting move in the move
+    // loop. Measures move ordering quality: ideally, most cutoffs happen on the first move.
+    uint64_t cutoffs[2][CUTOFF_DEPTH][CUTOFF_INDEX];
+    uint64_t cutoffIndexSum[2][CUTOFF_DEPTH]; // sum of (uncapped) indices, for the mean
+} SearchStats;
+
+#ifdef STATS
+    #define STAT_INC(worker, counter) ((worker)->stats.counters[counter]++)
+    #define STAT_ADD(worker, array, depth) ((worker)->stats.array[min(depth, STAT_MAX_DEPTH)]++)
+    #define STAT_CUTOFF(worker, pvNode, depth, index)                                              \
+        ((worker)->stats.cutoffs[pvNode][min(depth, CUTOFF_DEPTH) - 1]                             \
+                                [min(index, CUTOFF_INDEX) - 1]++,                                  \
+         (worker)->stats.cutoffIndexSum[pvNode][min(depth, CUTOFF_DEPTH) - 1] += (uint64_t)(index))
+#else
+    #define STAT_INC(worker, counter) ((void)0)
+    #define STAT_ADD(worker, array, depth) ((void)0)
+    #define STAT_CUTOFF(worker, pvNode, depth, index) ((void)0)
+#endif
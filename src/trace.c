@@ -0,0 +1,160 @@
+/*
+ * Demolito, a UCI chess engine. Copyright 2015-2020 lucasart.
+ *
+ * Demolito is free software: you can redistribute it and/or modify it under the terms of the GNU
+ * General Public License as published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * Demolito is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with this program. If
+ * not, see <http://www.gnu.org/licenses/>.
+ */
+#include "trace.h"
+#include "platform.h"
+#include "position.h"
+#include <stdlib.h>
+
+bool TraceEnabled = false;
+
+typedef struct {
+    uint64_t count; // events recorded, the last TRACE_SIZE of which are in events[]
+    TraceEvent events[TRACE_SIZE];
+} TraceRing;
+
+static TraceRing *Rings = NULL;
+static size_t RingsCount = 0;
+static int64_t Epoch = 0; // system_usec() when tracing was enabled
+
+static void __attribute__((destructor)) trace_free(void) { free(Rings); }
+
+static void trace_clear(void) {
+    for (size_t i = 0; i < RingsCount; i++)
+        Rings[i].count = 0;
+
+    Epoch = system_usec();
+}
+
+void trace_enable(bool enabled) {
+    if (enabled && !TraceEnabled)
+        trace_clear();
+
+    TraceEnabled = enabled;
+}
+
+void trace_prepare(size_t threads) {
+    if (threads == RingsCount)
+        return;
+
+    Rings = realloc(Rings, threads * sizeof(TraceRing));
+    RingsCount = threads;
+    trace_clear();
+}
+
+void trace_event(int thread, int type, int depth, int value, move_t move) {
+    if ((size_t)thread >= RingsCount)
+        return; // not a search_go() thread (eg. solo search)
+
+    TraceRing *ring = &Rings[thread];
+    ring->events[ring->count++ % TRACE_SIZE] = (TraceEvent){.time = system_usec() - Epoch,
+                                                            .value = value,
+                                                            .move = move,
+                                                            .type = (uint8_t)type,
+                                                            .depth = (int8_t)depth};
+}
+
+// Raw move encoding: castling is king takes rook
+static void move_to_string(move_t m, char str[6]) {
+    square_to_string(move_from(m), str);
+    square_to_string(move_to(m), str + 2);
+    str[4] = move_prom(m) < NB_PIECE ? PieceLabel[BLACK][move_prom(m)] : '\0';
+    str[5] = '\0';
+}
+
+static void write_event(FILE *out, int thread, const TraceEvent *e) {
+    static const char *StopReasons[] = {"stop or depth", "movetime", "nodes", "time",
+                                         "iteration"};
+    char move[6];
+
+    fprintf(out, "{\"pid\":1,\"tid\":%d,\"ts\":%" PRId64 ",", thread, e->time);
+
+    switch (e->type) {
+    case TRACE_SEARCH_START:
+        fputs("\"ph\":\"B\",\"name\":\"search\"}", out);
+        break;
+    case TRACE_SEARCH_END:
+        fputs("\"ph\":\"E\"}", out);
+        break;
+    case TRACE_ITERATION_START:
+        fprintf(out, "\"ph\":\"B\",\"name\":\"depth %d\"}", e->depth);
+        break;
+    case TRACE_ITERATION_END:
+        fprintf(out, "\"ph\":\"E\",\"args\":{\"cp\":%d}}", e->value / 2);
+        break;
+    case TRACE_ITERATION_ABORT:
+        fputs("\"ph\":\"E\",\"args\":{\"aborted\":true}}", out);
+        break;
+    case TRACE_FAIL_HIGH:
+    case TRACE_FAIL_LOW:
+        fprintf(out,
+                "\"ph\":\"i\",\"s\":\"t\",\"name\":\"%s\","
+                "\"args\":{\"depth\":%d,\"cp\":%d}}",
+                e->type == TRACE_FAIL_HIGH ? "fail high" : "fail low", e->depth, e->value / 2);
+        break;
+    case TRACE_BEST_MOVE:
+        move_to_string(e->move, move);
+        fprintf(out,
+                "\"ph\":\"i\",\"s\":\"t\",\"name\":\"best move\","
+                "\"args\":{\"depth\":%d,\"move\":\"%s\",\"cp\":%d}}",
+                e->depth, move, e->value / 2);
+        break;
+    case TRACE_STOP:
+        fprintf(out,
+                "\"ph\":\"i\",\"s\":\"p\",\"name\":\"stop\","
+                "\"args\":{\"depth\":%d,\"reason\":\"%s\"}}",
+                e->depth, StopReasons[e->value]);
+        break;
+    case TRACE_JOIN:
+        fprintf(out,
+                "\"ph\":\"i\",\"s\":\"t\",\"name\":\"join\",\"args\":{\"thread\":%d}}",
+                e->value);
+        break;
+    default:
+        assert(false);
+    }
+}
+
+bool trace_write(const char *fileName) {
+    FILE *out = fopen(fileName, "w");
+
+    if (!out)
+        return false;
+
+    fputs("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[", out);
+
+    for (size_t i = 0; i < RingsCount; i++) {
+        // Thread name: workers, then the timer thread running search_go()
+        fprintf(out, "%s\n{\"pid\":1,\"tid\":%zu,\"ph\":\"M\",\"name\":\"thread_name\",",
+                i ? "," : "", i);
+
+        if (i + 1 < RingsCount)
+            fprintf(out, "\"args\":{\"name\":\"worker %zu\"}}", i);
+        else
+            fputs("\"args\":{\"name\":\"timer\"}}", out);
+
+        // Events, oldest first
+        const TraceRing *ring = &Rings[i];
+        const uint64_t start = ring->count > TRACE_SIZE ? ring->count - TRACE_SIZE : 0;
+
+        for (uint64_t j = start; j < ring->count; j++) {
+            fputs(",\n", out);
+            write_event(out, (int)i, &ring->events[j % TRACE_SIZE]);
+        }
+    }
+
+    fputs("\n]}\n", out);
+    fclose(out);
+    return true;
+}
@@ -0,0 +1,66 @@
+/*
+ * Demolito, a UCI chess engine. Copyright 2015-2020 lucasart.
+ *
+ * Demolito is free software: you can redistribute it and/or modify it under the terms of the GNU
+ * General Public License as published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * Demolito is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with this program. If
+ * not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+#include "types.h"
+
+// Search event trace. Each thread records timestamped events in its own ring buffer, which keeps
+// the last TRACE_SIZE of them. trace_write() exports all rings as Chrome trace JSON, to view the
+// timeline of recent searches in chrome://tracing or ui.perfetto.dev.
+
+enum { TRACE_SIZE = 4096 }; // events per thread
+
+enum {
+    TRACE_SEARCH_START,    // search_go() timeline (timer thread)
+    TRACE_SEARCH_END,      //
+    TRACE_ITERATION_START, // depth
+    TRACE_ITERATION_END,   // depth, score
+    TRACE_ITERATION_ABORT, // depth (stopped before completion)
+    TRACE_FAIL_HIGH,       // aspiration window: depth, score
+    TRACE_FAIL_LOW,        //
+    TRACE_BEST_MOVE,       // best move changed during an iteration: depth, score, move
+    TRACE_STOP,            // stop signal seen by the timer thread: depth, reason (TRACE_STOP_*)
+    TRACE_JOIN,            // thread joined: index of the thread
+    NB_TRACE_EVENT
+};
+
+enum {
+    TRACE_STOP_OTHER,
+    TRACE_STOP_MOVETIME,
+    TRACE_STOP_NODES,
+    TRACE_STOP_TIME,
+    TRACE_STOP_ITERATION // next iteration would not finish in time
+};
+
+typedef struct {
+    int64_t time; // us since trace_enable()
+    int32_t value;
+    move_t move;
+    uint8_t type;
+    int8_t depth;
+} TraceEvent;
+
+extern bool TraceEnabled;
+
+// Record an event. Costs a single predictable branch when tracing is disabled: the arguments are
+// not even evaluated.
+#define TRACE(thread, type, depth, value, move)                                                    \
+    (__builtin_expect(TraceEnabled, 0) ? trace_event(thread, type, depth, value, move) : (void)0)
+
+void trace_enable(bool enabled); // enabling clears the trace
+void trace_prepare(size_t threads); // one ring per thread (realloc + clear if count changes)
+void trace_event(int thread, int type, int depth, int value, move_t move);
+
+// Write the trace as Chrome trace JSON. Returns false if the file can't be written.
+bool trace_write(const char *fileName);
@@ -181,14 +181,21 @@ typedef struct {
 static Sample *samples = NULL;
 static size_t sampleCount = 0;
 
+static bool is_binary(const char *fileName) {
+    const char *ext = strrchr(fileName, '.');
+    return ext && !strcmp(ext, ".bin");
+}
+
 void tune_load(const char *fileName) {
     size_t allocated = 1024;
     samples = malloc(allocated * sizeof(Sample));
 
-    FILE *in = fopen(fileName, "r");
+    const bool binary = is_binary(fileName);
+    FILE *in = fopen(fileName, binary ? "rb" : "r");
     char line[128] = "", *linePos = NULL;
+    PackedSample ps;
 
-    while (fgets(line, sizeof(line), in)) {
+    while (binary ? fread(&ps, sizeof(ps), 1, in) == 1 : fgets(line, sizeof(line), in) != NULL) {
         // Resize as needed
         if (sampleCount >= allocated) {
             allocated *= 2;
@@ -196,9 +203,17 @@ void tune_load(const char *fileName) {
         }
 
         // Load samples[sampleCount], translate eval into internal units (Tempo included)
-        strcpy(samples[sampleCount].fen, strtok_r(line, ",\n", &linePos));
-        samples[sampleCount].eval = (int16_t)(2 * atoi(strtok_r(NULL, ",\n", &linePos)));
-        samples[sampleCount].result = (int16_t)atoi(strtok_r(NULL, ",\n", &linePos));
+        if (binary) {
+            Position pos;
+            pos_unpack(&pos, &ps.pos);
+            pos_get(&pos, samples[sampleCount].fen);
+            samples[sampleCount].eval = (int16_t)(2 * ps.eval);
+            samples[sampleCount].result = ps.result;
+        } else {
+            strcpy(samples[sampleCount].fen, strtok_r(line, ",\n", &linePos));
+            samples[sampleCount].eval = (int16_t)(2 * atoi(strtok_r(NULL, ",\n", &linePos)));
+            samples[sampleCount].result = (int16_t)atoi(strtok_r(NULL, ",\n", &linePos));
+        }
 
         sampleCount++;
     }
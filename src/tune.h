@@ -13,7 +13,7 @@
  * not, see <http://www.gnu.org/licenses/>.
  */
 #pragma once
-#include "types.h"
+#include "position.h"
 
 extern int PieceValue[NB_PIECE + 1];
 
@@ -42,6 +42,14 @@ extern eval_t PasserBonus[6];
 extern int PasserAdjust[6];
 extern int FreePasser[4];
 
+// Training sample in binary format (.bin files). Eval in cp and result (0 = loss, 1 = draw,
+// 2 = win) are both from the side to move's pov, as in the CSV format "fen,eval,result".
+typedef struct __attribute__((packed)) {
+    PackedPos pos;
+    int16_t eval;
+    uint8_t result;
+} PackedSample;
+
 void tune_declare(void);
 void tune_parse(const char *fullName, int value);
 void tune_refresh(void);
@@ -17,8 +17,10 @@
 #include "eval.h"
 #include "gen.h"
 #include "htable.h"
+#include "perft.h"
 #include "position.h"
 #include "search.h"
+#include "trace.h"
 #include "tune.h"
 #include <math.h>
 #include <stdlib.h>
@@ -29,10 +31,10 @@
 
 static pthread_t Timer = 0;
 
-size_t uciHash = 2, uciThreads = 1;
-int uciLevel = 0;
+size_t uciHash = 2, uciPawnHash = 1024, uciThreads = 1;
+int uciLevel = 0, uciMultiPV = 1;
 int64_t uciTimeBuffer = 60;
-bool uciChess960 = false, uciFakeTime = false;
+bool uciChess960 = false, uciFakeTime = false, uciSharedPawnHash = false, uciCompactHash = false;
 
 static void uci_format_score(int score, char str[17]) {
     if (is_mate_score(score))
@@ -45,19 +47,32 @@ static void intro(void) {
     uci_puts("id name Demolito " VERSION "\nid author lucasart");
     uci_printf("option name Contempt type spin default %d min -100 max 100\n", Contempt);
     uci_printf("option name Hash type spin default %zu min 1 max 1048576\n", uciHash);
+    uci_printf("option name Compact Hash type check default %s\n",
+               uciCompactHash ? "true" : "false");
+    uci_printf("option name Pawn Hash type spin default %zu min 16 max 1048576\n", uciPawnHash);
+    uci_printf("option name Shared Pawn Hash type check default %s\n",
+               uciSharedPawnHash ? "true" : "false");
     uci_puts("option name Ponder type check default false");
+    uci_printf("option name MultiPV type spin default %d min 1 max %d\n", uciMultiPV, MAX_MOVES);
     uci_printf("option name Level type spin default %d min 0 max %d\n", uciLevel, NB_LEVEL);
     uci_printf("option name Threads type spin default %zu min 1 max 256\n", uciThreads);
     uci_printf("option name Time Buffer type spin default %" PRId64 " min 0 max 1000\n",
                uciTimeBuffer);
     uci_printf("option name UCI_Chess960 type check default %s\n", uciChess960 ? "true" : "false");
     uci_printf("option name Fake Time type check default %s\n", uciFakeTime ? "true" : "false");
+    uci_printf("option name Trace type check default %s\n", TraceEnabled ? "true" : "false");
 #ifdef TUNE
     tune_declare();
 #endif
     uci_puts("uciok");
 }
 
+// Last position command: GUIs resend the whole game on every move, so when a position command
+// extends the last one, only the new moves are played on rootPos.
+static char LastFen[MAX_FEN] = "";
+static char LastMoves[MAX_GAME_PLY][8];
+static int LastMovesCount = -1; // -1 = none yet
+
 static void setoption(char **linePos) {
     const char *token = strtok_r(NULL, " \n", linePos);
     char name[32] = "";
@@ -70,29 +85,43 @@ static void setoption(char **linePos) {
 
     token = strtok_r(NULL, " \n", linePos);
 
-    if (!strcmp(name, "UCI_Chess960"))
+    if (!strcmp(name, "UCI_Chess960")) {
         uciChess960 = !strcmp(token, "true");
-    else if (!strcmp(name, "FakeTime"))
+        LastMovesCount = -1; // castling moves are written differently
+    } else if (!strcmp(name, "FakeTime"))
         uciFakeTime = !strcmp(token, "true");
+    else if (!strcmp(name, "Trace"))
+        trace_enable(!strcmp(token, "true"));
     else if (!strcmp(name, "Hash")) {
         uciHash = (size_t)atoll(token);
         uciHash = 1ULL << bb_msb(uciHash); // must be a power of two
-        hash_prepare(uciHash);
+        hash_prepare(uciHash, uciCompactHash);
+    } else if (!strcmp(name, "CompactHash")) {
+        uciCompactHash = !strcmp(token, "true");
+        hash_prepare(uciLevel ? 1ULL << max(uciLevel - 9, 0) : uciHash, uciCompactHash);
+    } else if (!strcmp(name, "PawnHash")) {
+        uciPawnHash = (size_t)atoll(token);
+        workers_prepare_pawn_hash(uciPawnHash, uciSharedPawnHash);
+    } else if (!strcmp(name, "SharedPawnHash")) {
+        uciSharedPawnHash = !strcmp(token, "true");
+        workers_prepare_pawn_hash(uciPawnHash, uciSharedPawnHash);
     } else if (!strcmp(name, "Threads")) {
         uciThreads = (size_t)atoll(token);          // parse uciThreads
         workers_prepare(uciLevel ? 1 : uciThreads); // discard uciThreads when using levels
-    } else if (!strcmp(name, "Contempt"))
+    } else if (!strcmp(name, "MultiPV"))
+        uciMultiPV = atoi(token);
+    else if (!strcmp(name, "Contempt"))
         Contempt = atoi(token);
     else if (!strcmp(name, "Level")) {
         uciLevel = atoi(token);
 
         if (uciLevel) {
             // Switch on Level feature: discard uciHash and uciThreads
-            hash_prepare(1ULL << max(uciLevel - 9, 0)); // use level based hash size
-            workers_prepare(1);                         // always use 1 thread
+            hash_prepare(1ULL << max(uciLevel - 9, 0), uciCompactHash); // level based hash size
+            workers_prepare(1); // always use 1 thread
         } else {
             // Swithcing off Level feature: restore hash size and threads to UCI option values
-            hash_prepare(uciHash);
+            hash_prepare(uciHash, uciCompactHash);
             workers_prepare(uciThreads);
         }
     } else if (!strcmp(name, "TimeBuffer"))
@@ -104,7 +133,7 @@ static void setoption(char **linePos) {
     }
 }
 
-static void position(char **linePos) {
+void uci_position(char **linePos, bool incremental) {
     Position pos[NB_COLOR];
     int idx = 0;
 
@@ -120,29 +149,78 @@ static void position(char **linePos) {
     } else
         return;
 
-    pos_set(&pos[idx], fen);
-    zobrist_clear(&rootStack);
-    zobrist_push(&rootStack, pos[idx].key);
+    const char *moves[MAX_GAME_PLY];
+    int movesCount = 0;
 
-    // Parse moves (if any)
     while ((token = strtok_r(NULL, " \n", linePos))) {
-        move_t m = pos_string_to_move(&pos[idx], token);
+        // rootStack holds the initial position and MAX_GAME_PLY - 1 moves
+        if (movesCount == MAX_GAME_PLY - 1) {
+            uci_printf("info string too many moves, ignoring those after move %d\n", movesCount);
+            break;
+        }
+
+        moves[movesCount++] = token;
+    }
+
+    // Same FEN, and the last moves are a prefix of the new ones: rootPos and rootStack are there
+    int start = 0;
+
+    if (incremental && LastMovesCount >= 0 && LastMovesCount <= movesCount &&
+        rootStack.idx == LastMovesCount + 1 && !strcmp(fen, LastFen)) {
+        while (start < LastMovesCount && !strcmp(moves[start], LastMoves[start]))
+            start++;
+
+        start = start == LastMovesCount ? start : 0;
+    }
+
+    if (start)
+        pos[idx] = rootPos;
+    else {
+        pos_set(&pos[idx], fen);
+        zobrist_clear(&rootStack);
+        zobrist_push(&rootStack, pos[idx].key);
+    }
+
+    for (int i = start; i < movesCount; i++) {
+        move_t m = pos_string_to_move(&pos[idx], moves[i]);
         pos_move(&pos[idx ^ 1], &pos[idx], m);
         idx ^= 1;
         zobrist_push(&rootStack, pos[idx].key);
+
+        strncpy(LastMoves[i], moves[i], sizeof(LastMoves[i]) - 1);
+        LastMoves[i][sizeof(LastMoves[i]) - 1] = '\0';
     }
 
+    strcpy(LastFen, fen);
+    LastMovesCount = movesCount;
     rootPos = pos[idx];
 }
 
+// Return the legal move of pos in UCI notation str, or 0 if there is none
+static move_t parse_legal_move(const Position *pos, const char *str) {
+    move_t mList[MAX_MOVES];
+    const move_t *end = gen_all_moves(pos, mList);
+    char moveStr[6];
+
+    for (const move_t *m = mList; m != end; m++) {
+        pos_move_to_string(pos, *m, moveStr);
+
+        if (!strcmp(moveStr, str))
+            return *m;
+    }
+
+    return 0;
+}
+
 static void go(char **linePos) {
     lim = (Limits){.depth = MAX_DEPTH};
 
     const char *token = NULL;
+    bool searchMoves = false;
 
     while ((token = strtok_r(NULL, " \n", linePos))) {
         if (!strcmp(token, "depth"))
-            lim.depth = atoi(strtok_r(NULL, " \n", linePos));
+            lim.depth = min(atoi(strtok_r(NULL, " \n", linePos)), MAX_DEPTH);
         else if (!strcmp(token, "nodes"))
             lim.nodes = (uint64_t)atoll(strtok_r(NULL, " \n", linePos));
         else if (!strcmp(token, "movetime"))
@@ -155,8 +233,19 @@ static void go(char **linePos) {
         else if ((rootPos.turn == WHITE && !strcmp(token, "winc")) ||
                  (rootPos.turn == BLACK && !strcmp(token, "binc")))
             lim.inc = atoll(strtok_r(NULL, " \n", linePos));
-        else if (!strcmp(token, "infinite") || !strcmp(token, "ponder"))
+        else if (!strcmp(token, "infinite"))
             lim.infinite = true;
+        else if (!strcmp(token, "ponder"))
+            lim.infinite = lim.ponder = true;
+        else if (!strcmp(token, "searchmoves"))
+            searchMoves = true;
+        else if (searchMoves) {
+            // Moves follow "searchmoves" (illegal ones are ignored)
+            const move_t m = parse_legal_move(&rootPos, token);
+
+            if (m && lim.searchMovesCount < MAX_MOVES)
+                lim.searchMoves[lim.searchMovesCount++] = m;
+        }
     }
 
     if (uciLevel) {
@@ -185,18 +274,19 @@ static void eval(void) {
     uci_printf("score %s\n", str);
 }
 
-static void perft(char **linePos) {
+static void run_perft(char **linePos) {
     const int depth = atoi(strtok_r(NULL, " \n", linePos));
     const char *last = strtok_r(NULL, " \n", linePos);
-    uci_printf("%" PRIu64 "\n", gen_perft(&rootPos, depth, !last || strcmp(last, "div")));
+    const bool div = last && !strcmp(last, "div");
+    uci_printf("%" PRIu64 "\n", perft(&rootPos, depth, uciThreads, uciHash, div));
 }
 
 Info ui;
 
 void uci_loop(void) {
-    char line[8192], *linePos;
+    char line[16384], *linePos; // fits a position command with MAX_GAME_PLY moves
 
-    while (fgets(line, 8192, stdin)) {
+    while (fgets(line, sizeof line, stdin)) {
         const char *token = strtok_r(line, " \n", &linePos);
 
         if (!strcmp(token, "uci"))
@@ -209,26 +299,46 @@ void uci_loop(void) {
             hash_clear();
             workers_clear();
             hashDate = 0;
+            LastMovesCount = -1;
 #ifdef TUNE
             tune_refresh();
 #endif
         } else if (!strcmp(token, "position"))
-            position(&linePos);
+            uci_position(&linePos, true);
         else if (!strcmp(token, "go"))
             go(&linePos);
         else if (!strcmp(token, "stop")) {
-            lim.infinite = false;
-            Stop = true;
-        } else if (!strcmp(token, "ponderhit"))
-            lim.infinite = false; // switch from pondering to normal search
-        else if (!strcmp(token, "d"))
+            atomic_store_explicit(&lim.infinite, false, memory_order_release);
+            atomic_store_explicit(&Stop, true, memory_order_release);
+        } else if (!strcmp(token, "ponderhit")) {
+            // Switch from pondering to normal search. Our clock starts now. Release: the timer
+            // thread sees ponderhit once it sees infinite cleared.
+            atomic_store_explicit(&lim.ponderhit, system_msec(), memory_order_relaxed);
+            atomic_store_explicit(&lim.infinite, false, memory_order_release);
+        } else if (!strcmp(token, "d"))
             pos_print(&rootPos);
         else if (!strcmp(token, "eval"))
             eval();
         else if (!strcmp(token, "perft"))
-            perft(&linePos);
-        else if (!strcmp(token, "quit")) {
-            Stop = true;
+            run_perft(&linePos);
+        else if (!strcmp(token, "stats")) {
+#ifdef STATS
+            workers_print_stats(); // since ucinewgame
+#else
+            uci_puts("info string search statistics not compiled (make stats)");
+#endif
+        } else if (!strcmp(token, "trace")) {
+            const char *fileName = strtok_r(NULL, " \n", &linePos);
+            fileName = fileName ? fileName : "trace.json";
+
+            if (!TraceEnabled)
+                uci_puts("info string tracing is disabled (setoption name Trace value true)");
+            else if (trace_write(fileName))
+                uci_printf("info string trace written to %s\n", fileName);
+            else
+                uci_printf("info string cannot write %s\n", fileName);
+        } else if (!strcmp(token, "quit")) {
+            atomic_store_explicit(&Stop, true, memory_order_release);
             break;
         } else if (!strcmp(token, "load"))
             tune_load(strtok_r(NULL, " \n", &linePos));
@@ -259,41 +369,59 @@ void uci_loop(void) {
 void info_create(Info *info) {
     info->lastDepth = 0;
     info->variability = 0;
+    info->effort = 0;
     info->best = info->ponder = 0;
     info->start = system_msec();
+    info->bestTime = 0;
+    info->lastBest = 0;
+    info->lastScore = info->scoreDrop = info->stability = 0;
+    info->iterationEnd = info->iterationTime = 0;
     mtx_init(&info->mtx, mtx_plain);
 }
 
 void info_destroy(Info *info) { mtx_destroy(&info->mtx); }
 
-void info_update(Info *info, int depth, int score, uint64_t nodes, move_t pv[], bool partial) {
+static void info_print_line(const Info *info, int depth, int multiPV, int score, uint64_t nodes,
+                            const move_t pv[]) {
+    // Print info line all the way to the "pv" token
+    char str[17];
+    uci_format_score(score, str);
+    const int64_t elapsed = system_msec() - info->start;
+    uci_printf("info depth %d", depth);
+
+    if (uciMultiPV > 1)
+        uci_printf(" multipv %d", multiPV);
+
+    uci_printf(" score %s time %" PRId64 " nodes %" PRIu64 " nps %" PRIu64 " hashfull %d pv", str,
+               elapsed, nodes, 1000 * nodes / (uint64_t)max(elapsed, 1), hash_permille());
+
+    // Pring the moves. Because of e1g1 notation when Chess960 = false, we need to play the PV
+    // to print it correctly. This is a design flaw of the UCI protocol, which should have
+    // encoded castling as e1h1 regardless of Chess960 allowing coherent treatement.
+    Position pos[NB_COLOR];
+    int idx = 0;
+    pos[idx] = rootPos;
+
+    for (int i = 0; pv[i]; i++) {
+        pos_move_to_string(&pos[idx], pv[i], str);
+        uci_printf(" %s", str);
+        pos_move(&pos[idx ^ 1], &pos[idx], pv[i]);
+        idx ^= 1;
+    }
+
+    uci_puts("");
+}
+
+void info_update(Info *info, int depth, uint64_t nodes, const RootMove lines[], int count,
+                 bool partial, double effort) {
     mtx_lock(&info->mtx);
 
     if (depth > info->lastDepth) {
-        // Print info line all the way to the "pv" token
-        char str[17];
-        uci_format_score(score, str);
-        const int64_t elapsed = system_msec() - info->start;
-        uci_printf("info depth %d score %s time %" PRId64 " nodes %" PRIu64 " nps %" PRIu64
-                   " hashfull %d pv",
-                   depth, str, elapsed, nodes, 1000 * nodes / (uint64_t)max(elapsed, 1),
-                   hash_permille());
-
-        // Pring the moves. Because of e1g1 notation when Chess960 = false, we need to play the PV
-        // to print it correctly. This is a design flaw of the UCI protocol, which should have
-        // encoded castling as e1h1 regardless of Chess960 allowing coherent treatement.
-        Position pos[NB_COLOR];
-        int idx = 0;
-        pos[idx] = rootPos;
-
-        for (int i = 0; pv[i]; i++) {
-            pos_move_to_string(&pos[idx], pv[i], str);
-            uci_printf(" %s", str);
-            pos_move(&pos[idx ^ 1], &pos[idx], pv[i]);
-            idx ^= 1;
-        }
+        // PV lines are ordered, best first
+        for (int i = 0; i < count; i++)
+            info_print_line(info, depth, i + 1, lines[i].score, nodes, lines[i].pv);
 
-        uci_puts("");
+        const move_t *pv = lines[0].pv;
 
         // Update variability depending on whether the bestmove has changed or is confirmed
         // - changed: increase variability (rescale for %age of partial updates = f(threads))
@@ -301,8 +429,26 @@ void info_update(Info *info, int depth, int score, uint64_t nodes, move_t pv[],
         info->variability +=
             info->best != pv[0] ? 0.6 * pow((double)WorkersCount, -0.08) : -0.24 * !partial;
 
-        if (!partial)
+        if (!partial) {
+            const int64_t elapsed = system_msec() - info->start;
+            const int score = lines[0].score;
+
+            // Score drops are meaningless with mate scores: count them as no drop
+            info->scoreDrop = info->lastDepth && abs(score) < MATE - MAX_PLY &&
+                                      abs(info->lastScore) < MATE - MAX_PLY
+                                  ? info->lastScore - score
+                                  : 0;
+            info->stability = info->lastBest == pv[0] ? info->stability + 1 : 0;
+            info->iterationTime = elapsed - info->iterationEnd;
+            info->iterationEnd = elapsed;
+            info->lastScore = score;
+            info->lastBest = pv[0];
             info->lastDepth = depth;
+            info->effort = effort;
+        }
+
+        if (info->best != pv[0])
+            info->bestTime = system_msec() - info->start;
 
         info->best = pv[0];
         info->ponder = pv[1]; // May be zero (not a bug, inevitable consequence of partial updates)
@@ -352,3 +498,17 @@ double info_variability(Info *info) {
 
     return variability;
 }
+
+SearchProgress info_progress(Info *info) {
+    mtx_lock(&info->mtx);
+    const SearchProgress progress = {.depth = info->lastDepth,
+                                     .scoreDrop = info->scoreDrop,
+                                     .stability = info->stability,
+                                     .iterationEnd = info->iterationEnd,
+                                     .iterationTime = info->iterationTime,
+                                     .variability = info->variability,
+                                     .effort = info->effort};
+    mtx_unlock(&info->mtx);
+
+    return progress;
+}
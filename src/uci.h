@@ -15,31 +15,55 @@
 #pragma once
 #include "platform.h"
 #include "position.h"
+#include "search.h"
 
 enum { NB_LEVEL = 12 };
 enum { MOVESTOGO = 26 };
 
 void uci_loop(void);
 
+// Parse a position command (after the "position" token), and set rootPos and rootStack. If
+// incremental, and the last position command is a prefix of this one, play only the new moves.
+void uci_position(char **linePos, bool incremental);
+
 typedef struct {
     mtx_t mtx;
     int64_t start;
+    int64_t bestTime; // when the best move last changed, relative to start
     double variability;
+    double effort; // share of the nodes spent on the best move, by the thread completing lastDepth
     int lastDepth;
     move_t best, ponder;
+
+    // Completed iterations (see SearchProgress)
+    move_t lastBest;
+    int lastScore, scoreDrop, stability;
+    int64_t iterationEnd, iterationTime;
 } Info;
 
+// Search progress at the last completed iteration, for time management (see search_go())
+typedef struct {
+    int depth;             // last completed depth (0 = none yet)
+    int scoreDrop;         // best score of the previous iteration - best score of the last one
+    int stability;         // consecutive iterations confirming the best move (0 = it just changed)
+    int64_t iterationEnd;  // when the last iteration completed (ms from the start)
+    int64_t iterationTime; // how long it took (ms)
+    double variability, effort;
+} SearchProgress;
+
 extern Info ui;
-extern int uciLevel;
+extern int uciLevel, uciMultiPV;
 extern int64_t uciTimeBuffer;
-extern bool uciChess960, uciFakeTime;
-extern size_t uciHash, uciThreads;
+extern bool uciChess960, uciFakeTime, uciSharedPawnHash, uciCompactHash;
+extern size_t uciHash, uciPawnHash, uciThreads;
 
 void info_create(Info *info);
 void info_destroy(Info *info);
 
-void info_update(Info *info, int depth, int score, uint64_t nodes, move_t pv[], bool partial);
+void info_update(Info *info, int depth, uint64_t nodes, const RootMove lines[], int count,
+                 bool partial, double effort);
 void info_print_bestmove(Info *info);
 move_t info_best(Info *info);
 int info_last_depth(Info *info);
 double info_variability(Info *info);
+SearchProgress info_progress(Info *info);
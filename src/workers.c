@@ -13,21 +13,50 @@
  * not, see <http://www.gnu.org/licenses/>.
  */
 #include "workers.h"
+#include "htable.h"
 #include "platform.h"
 #include "search.h"
 #include <stdlib.h>
+#include <string.h>
 
 Worker *Workers = NULL;
 size_t WorkersCount = 0;
 
-static void __attribute__((destructor)) workers_free(void) { free(Workers); }
+// Pawn hash tables of all workers, in one cache line aligned block. PawnBlock is what malloc()
+// returned, and PawnTables is PawnBlock rounded up to the next cache line.
+static void *PawnBlock = NULL;
+static PawnEntry *PawnTables = NULL;
+static size_t PawnHashCount = 16384; // entries per table
+static bool PawnHashShared = false;
+
+static void __attribute__((destructor)) workers_free(void) {
+    free(Workers);
+    free(PawnBlock);
+}
+
+// Allocate pawn hash tables, and point each worker to its own (or to the shared one)
+static void pawn_hash_alloc(void) {
+    const size_t tables = PawnHashShared ? 1 : WorkersCount;
+    free(PawnBlock);
+    PawnBlock = malloc(tables * PawnHashCount * sizeof(PawnEntry) + 63);
+    PawnTables = (PawnEntry *)(((uintptr_t)PawnBlock + 63) & ~(uintptr_t)63);
+
+    for (size_t i = 0; i < WorkersCount; i++) {
+        Workers[i].pawnHash = PawnTables + (PawnHashShared ? 0 : i * PawnHashCount);
+        Workers[i].pawnHashMask = PawnHashCount - 1;
+    }
+}
 
 void workers_clear(void) {
     for (size_t i = 0; i < WorkersCount; i++) {
-        // Clear Workers[i] except .seed, which must be preserved
-        uint64_t saveSeed = Workers[i].seed;
-        Workers[i] = (Worker){.seed = saveSeed};
+        // Clear Workers[i] except .seed and pawn hash pointers, which must be preserved
+        const uint64_t saveSeed = Workers[i].seed;
+        PawnEntry *savePawnHash = Workers[i].pawnHash;
+        Workers[i] =
+            (Worker){.seed = saveSeed, .pawnHash = savePawnHash, .pawnHashMask = PawnHashCount - 1};
     }
+
+    memset(PawnTables, 0, (PawnHashShared ? 1 : WorkersCount) * PawnHashCount * sizeof(PawnEntry));
 }
 
 void workers_prepare(size_t count) {
@@ -40,12 +69,23 @@ void workers_prepare(size_t count) {
     for (size_t i = 0; i < count; i++)
         Workers[i].seed = (uint64_t)system_msec() + i;
 
+    pawn_hash_alloc();
+    workers_clear();
+}
+
+void workers_prepare_pawn_hash(size_t pawnHashKB, bool shared) {
+    const size_t entries = max((pawnHashKB << 10) / sizeof(PawnEntry), (size_t)1); // at least one
+    PawnHashCount = 1ULL << bb_msb(entries);                                         // power of 2
+    PawnHashShared = shared;
+
+    pawn_hash_alloc();
     workers_clear();
 }
 
 void workers_new_search(void) {
     for (size_t i = 0; i < WorkersCount; i++) {
         Workers[i].stack = rootStack;
+        Workers[i].hash = hash_partition(0, 1);
         Workers[i].nodes = 0;
     }
 }
@@ -58,3 +98,142 @@ uint64_t workers_nodes(void) {
 
     return total;
 }
+
+void workers_print_aspiration(void) {
+    AspirationStats total[MAX_DEPTH + 1] = {0};
+
+    for (size_t i = 0; i < WorkersCount; i++)
+        for (int d = 0; d <= MAX_DEPTH; d++) {
+            const AspirationStats *a = &Workers[i].aspiration[d];
+            total[d].searches += a->searches;
+            total[d].failHighs += a->failHighs;
+            total[d].failLows += a->failLows;
+            total[d].nodes += a->nodes;
+            total[d].failedNodes += a->failedNodes;
+        }
+
+    // Per depth: searches, fail highs, fail lows, and share of the nodes spent in failed searches
+    puts("aspiration  searches  fail high  fail low  re-search nodes");
+
+    for (int d = 0; d <= MAX_DEPTH; d++)
+        if (total[d].searches)
+            printf("%5d %14" PRIu64 " %10" PRIu64 " %9" PRIu64 " %15.1f%%\n", d, total[d].searches,
+                   total[d].failHighs, total[d].failLows,
+                   100.0 * (double)total[d].failedNodes / (double)max(total[d].nodes, 1));
+}
+
+#ifdef STATS
+void workers_print_stats(void) {
+    static const struct {
+        const char *name;
+        int attempts, hits;
+    } Rows[] = {
+        {"eval pruning", STAT_EVAL_PRUNE, STAT_EVAL_PRUNE_CUT},
+        {"razoring", STAT_RAZOR, STAT_RAZOR_CUT},
+        {"null move", STAT_NULL, STAT_NULL_CUT},
+        {"probcut", STAT_PROBCUT, STAT_PROBCUT_CUT},
+        {"see pruning", STAT_LATE, STAT_SEE_PRUNE},
+        {"late move pruning", STAT_LATE, STAT_LMP},
+        {"history pruning", STAT_LATE, STAT_HISTORY_PRUNE},
+        {"singular extension", STAT_SINGULAR, STAT_SINGULAR_EXT},
+        {"lmr re-search", STAT_LMR, STAT_LMR_RESEARCH},
+        {"pvs re-search", STAT_PVS, STAT_PVS_RESEARCH},
+        {"pawn hash hit", STAT_PAWN_PROBE, STAT_PAWN_HIT},
+        {"lazy eval exit", STAT_LAZY_PROBE, STAT_LAZY_EXIT},
+    };
+
+    SearchStats total = {0};
+
+    for (size_t i = 0; i < WorkersCount; i++) {
+        for (int j = 0; j < NB_STAT; j++)
+            total.counters[j] += Workers[i].stats.counters[j];
+
+        for (int d = 0; d <= STAT_MAX_DEPTH; d++) {
+            total.nodes[d] += Workers[i].stats.nodes[d];
+            total.moves[d] += Workers[i].stats.moves[d];
+        }
+    }
+
+    puts("statistic              attempts          hits");
+
+    for (size_t i = 0; i < sizeof(Rows) / sizeof(Rows[0]); i++) {
+        const uint64_t attempts = total.counters[Rows[i].attempts];
+        const uint64_t hits = total.counters[Rows[i].hits];
+        printf("%-18s %12" PRIu64 " %12" PRIu64 " (%.1f%%)\n", Rows[i].name, attempts, hits,
+               100.0 * (double)hits / (double)max(attempts, 1));
+    }
+
+    printf("check extension                 %12" PRIu64 "\n", total.counters[STAT_CHECK_EXT]);
+
+    // Branching factor: moves searched per node, by depth
+    puts("depth        nodes   branching");
+
+    for (int d = 1; d <= STAT_MAX_DEPTH; d++)
+        if (total.nodes[d])
+            printf("%5d %12" PRIu64 " %11.2f\n", d, total.nodes[d],
+                   (double)total.moves[d] / (double)total.nodes[d]);
+}
+
+static void print_cutoff_cells(const uint64_t hist[CUTOFF_INDEX], uint64_t indexSum) {
+    uint64_t count = 0;
+
+    for (int i = 0; i < CUTOFF_INDEX; i++)
+        count += hist[i];
+
+    if (count)
+        printf(" %12" PRIu64 " %6.1f%% %6.2f", count, 100.0 * (double)hist[0] / (double)count,
+               (double)indexSum / (double)count);
+    else
+        printf(" %12s %7s %6s", "-", "-", "-");
+}
+
+void workers_print_cutoffs(void) {
+    uint64_t hist[2][CUTOFF_DEPTH + 1][CUTOFF_INDEX] = {0}; // last depth row = all depths
+    uint64_t indexSum[2][CUTOFF_DEPTH + 1] = {0};
+
+    for (size_t i = 0; i < WorkersCount; i++)
+        for (int t = 0; t < 2; t++)
+            for (int d = 0; d < CUTOFF_DEPTH; d++) {
+                indexSum[t][d] += Workers[i].stats.cutoffIndexSum[t][d];
+                indexSum[t][CUTOFF_DEPTH] += Workers[i].stats.cutoffIndexSum[t][d];
+
+                for (int j = 0; j < CUTOFF_INDEX; j++) {
+                    hist[t][d][j] += Workers[i].stats.cutoffs[t][d][j];
+                    hist[t][CUTOFF_DEPTH][j] += Workers[i].stats.cutoffs[t][d][j];
+                }
+            }
+
+    // Per depth: number of cutoffs, % on the first move, mean index of the cutting move (1 = first)
+    puts("cutoffs ---------- non-pv ---------- ------------ pv ------------");
+    puts("depth          count   first   mean        count   first   mean");
+
+    for (int d = 0; d <= CUTOFF_DEPTH; d++) {
+        if (!indexSum[0][d] && !indexSum[1][d])
+            continue;
+
+        if (d == CUTOFF_DEPTH)
+            printf("%-5s  ", "all");
+        else
+            printf("%3d%-2s  ", d + 1, d == CUTOFF_DEPTH - 1 ? "+" : "");
+
+        print_cutoff_cells(hist[0][d], indexSum[0][d]);
+        print_cutoff_cells(hist[1][d], indexSum[1][d]);
+        puts("");
+    }
+
+    // Distribution of the cutting move index, all depths
+    for (int t = 0; t < 2; t++) {
+        uint64_t count = 0;
+
+        for (int j = 0; j < CUTOFF_INDEX; j++)
+            count += hist[t][CUTOFF_DEPTH][j];
+
+        printf("%-6s %%", t ? "pv" : "non-pv");
+
+        for (int j = 0; j < CUTOFF_INDEX; j++)
+            printf(" %.1f", 100.0 * (double)hist[t][CUTOFF_DEPTH][j] / (double)max(count, 1));
+
+        puts("");
+    }
+}
+#endif
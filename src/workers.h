@@ -14,35 +14,87 @@
  */
 #pragma once
 #include "bitboard.h"
+#include "htable.h"
 #include "search.h"
+#include "stats.h"
 #include "zobrist.h"
 #include <setjmp.h>
 
-enum { NB_PAWN_HASH = 16384, NB_REFUTATION = 1024, NB_FOLLOW_UP = 1024 };
+enum { NB_REFUTATION = 1024, NB_FOLLOW_UP = 1024 };
 
-typedef struct {
-    uint64_t key;
-    bitboard_t passed;
-    eval_t eval;
+// King+pawn evaluation and invariants, which depend only on pos->kingPawnKey. Aligned on a cache
+// line, so that a probe never touches two cache lines. The king shield score depends only on king
+// and pawn squares, so it is cached as part of eval (see do_pawns()). The king danger zones are
+// not cached: each is one AND of KingAttacks and pawnAttacks, and two more bitboards would not
+// fit in the cache line (8 bytes left).
+typedef struct __attribute__((aligned(64))) {
+    uint64_t keyXor;        // key ^ all other fields: detects torn entries (lockless sharing)
+    bitboard_t passerStops; // stop squares of passed pawns on relative ranks 4..7 (both colors)
+    bitboard_t pawnAttacks[NB_COLOR];
+    bitboard_t semiOpen[NB_COLOR]; // squares with no pawn of that color ahead (rook on open file)
+    union {
+        eval_t eval;
+        uint64_t evalBits;
+    };
 } PawnEntry;
 
+// Aspiration searches of one depth (all root lines), and how many failed high or low. Nodes are
+// counted for all searches, and for failed ones only (re-search overhead).
 typedef struct {
-    PawnEntry pawnHash[NB_PAWN_HASH];
+    uint64_t searches, failHighs, failLows;
+    uint64_t nodes, failedNodes;
+} AspirationStats;
+
+typedef struct Worker {
+    PawnEntry *pawnHash; // private, or shared by all workers (see workers_prepare_pawn_hash())
+    size_t pawnHashMask;
+
     int16_t history[NB_COLOR][NB_SQUARE][NB_SQUARE];
     int16_t refutationHistory[NB_REFUTATION][NB_PIECE][NB_SQUARE];
     int16_t followUpHistory[NB_FOLLOW_UP][NB_PIECE][NB_SQUARE];
     ZobristStack stack;
+    HashTable hash; // whole hash table, or a partition of it for solo searches
     jmp_buf jbuf;
     uint64_t nodes;
     uint64_t seed;
     int eval[MAX_PLY];
+
+    // Root moves, best first. PV lines 0..pvIdx-1 of the current iteration are excluded from the
+    // root search, to find the next best line (MultiPV).
+    RootMove rootMoves[MAX_MOVES];
+    int rootMovesCount, pvIdx;
+    bool rootRestricted;                 // root moves restricted by Limits.searchMoves
+    uint64_t lastRootKey;                // root of the last search (0 = none)
+
+    AspirationStats aspiration[MAX_DEPTH + 1]; // per depth, since the last workers_clear()
+
+#ifdef STATS
+    SearchStats stats; // since the last workers_clear()
+#endif
+
+    // Solo search: independent from search_go() and the UCI state (see search_solo())
+    uint64_t maxNodes;   // stop when nodes reaches maxNodes (0 = no limit)
+    int64_t deadline;    // stop when system_msec() reaches deadline (0 = no limit)
+    uint64_t clockNodes; // node count at which to check the deadline next
+    int64_t start;       // when the search started
+    move_t bestMove;     // root best move, updated as soon as it changes ...
+    int64_t bestTime;    // ... when it last changed (ms from the start) ...
+    uint64_t bestNodes;  // ... and the node count at that time
+    bool solo;
 } Worker;
 
 extern Worker *Workers;
 extern size_t WorkersCount;
 
 void workers_clear(void);
-void workers_prepare(size_t count); // realloc + clear
+void workers_prepare(size_t count);                              // realloc + clear
+void workers_prepare_pawn_hash(size_t pawnHashKB, bool shared); // realloc + clear
 
 void workers_new_search(void);
 uint64_t workers_nodes(void);
+void workers_print_aspiration(void); // aspiration statistics of all workers combined
+
+#ifdef STATS
+void workers_print_stats(void);   // search statistics of all workers combined
+void workers_print_cutoffs(void); // cutoff histogram of all workers combined
+#endif